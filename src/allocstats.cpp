@@ -0,0 +1,61 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+#include "allocstats.h"
+#include <new>
+
+// per thread, so that the render and asset threads don't show up in counts taken on the main thread
+static thread_local Uint64 thread_allocations = 0;
+
+Uint64 getThreadAllocationCount()
+{
+    return thread_allocations;
+}
+
+// Replacements for the global allocation functions: the same as the default ones,
+// except that every allocation is counted
+void *operator new(std::size_t size)
+{
+    thread_allocations++;
+
+    void *p = std::malloc(size > 0 ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    thread_allocations++;
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return operator new(size,std::nothrow);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
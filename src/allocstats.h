@@ -0,0 +1,14 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+#ifndef ALLOCSTATS_H_
+#define ALLOCSTATS_H_
+
+#include "globals.h"
+
+// Number of heap allocations (operator new calls) made so far by the calling thread.
+// The difference between two calls on the same thread is how often the code in
+// between allocated, no matter which container or string did it.
+Uint64 getThreadAllocationCount();
+
+#endif
@@ -0,0 +1,168 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+#include "bundle.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+asset_bundle::asset_bundle()
+{
+    data = NULL;
+    data_size = 0;
+    header = NULL;
+    entries = NULL;
+    file_handle = NULL;
+    mapping_handle = NULL;
+}
+
+asset_bundle::~asset_bundle()
+{
+    close();
+}
+
+// Map the bundle file and check its index. Returns false (and maps nothing) if
+// the file is missing or isn't a bundle of this version.
+bool asset_bundle::open(std::string file_name)
+{
+    close();
+
+#ifdef _WIN32
+    // the file is read front to back once, so tell the cache manager to read ahead
+    HANDLE file = CreateFileA(file_name.c_str(),GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file,&file_size) || file_size.QuadPart < (LONGLONG)sizeof(bundle_header))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file,NULL,PAGE_READONLY,0,0,NULL);
+    const Uint8 *view = (mapping != NULL ? (const Uint8 *)MapViewOfFile(mapping,FILE_MAP_READ,0,0,0) : NULL);
+    if (view == NULL)
+    {
+        if (mapping != NULL)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    file_handle = (void *)file;
+    mapping_handle = (void *)mapping;
+    data = view;
+    data_size = (Uint64)file_size.QuadPart;
+#else
+    int fd = ::open(file_name.c_str(),O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat file_stat;
+    if (fstat(fd,&file_stat) != 0 || file_stat.st_size < (off_t)sizeof(bundle_header))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *view = mmap(NULL,(size_t)file_stat.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+
+    // the file is read front to back once, so ask for read ahead
+    posix_madvise(view,(size_t)file_stat.st_size,POSIX_MADV_SEQUENTIAL);
+
+    data = (const Uint8 *)view;
+    data_size = (Uint64)file_stat.st_size;
+#endif
+
+    header = (const bundle_header *)data;
+    entries = (const bundle_entry *)(data + sizeof(bundle_header));
+
+    if (!checkIndex())
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void asset_bundle::close()
+{
+    if (data == NULL)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile((LPCVOID)data);
+    CloseHandle((HANDLE)mapping_handle);
+    CloseHandle((HANDLE)file_handle);
+#else
+    munmap((void *)data,(size_t)data_size);
+#endif
+
+    data = NULL;
+    data_size = 0;
+    header = NULL;
+    entries = NULL;
+    file_handle = NULL;
+    mapping_handle = NULL;
+}
+
+bool asset_bundle::isOpen()
+{
+    return data != NULL;
+}
+
+// Is every index entry (and the data it points to) inside the file?
+bool asset_bundle::checkIndex()
+{
+    if (memcmp(header->magic,BUNDLE_MAGIC,8) != 0 || header->version != BUNDLE_VERSION)
+        return false;
+
+    if ((Uint64)header->num_entries > (data_size - sizeof(bundle_header)) / sizeof(bundle_entry))
+        return false;
+
+    for (int i = 0; i < (int)header->num_entries; ++i)
+    {
+        const bundle_entry *entry = &entries[i];
+        if (entry->name[BUNDLE_NAME_LENGTH - 1] != '\0')
+            return false;
+        if (entry->offset > data_size || entry->size > data_size - entry->offset)
+            return false;
+        if (entry->type == BUNDLEENTRY_IMAGE && entry->size != (Uint64)entry->width * (Uint64)entry->height * 4)
+            return false;
+    }
+
+    return true;
+}
+
+// Were the sounds converted to the format the mixer was opened with?
+bool asset_bundle::hasSoundFormat(int frequency, Uint16 format, int channels)
+{
+    return header->sound_frequency == (Uint32)frequency && header->sound_format == format && header->sound_channels == (Uint16)channels;
+}
+
+// Entry of file name "name", or NULL if the bundle doesn't have it
+const bundle_entry *asset_bundle::findEntry(std::string name, bundle_entry_type type)
+{
+    for (int i = 0; i < (int)header->num_entries; ++i)
+    {
+        if (entries[i].type == (Uint32)type && name == entries[i].name)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+const Uint8 *asset_bundle::getEntryData(const bundle_entry *entry)
+{
+    return data + entry->offset;
+}
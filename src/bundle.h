@@ -0,0 +1,72 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+#ifndef BUNDLE_H_
+#define BUNDLE_H_
+
+#include "globals.h"
+
+// Asset bundle written by tools/bundlepack.cpp (all values little endian):
+// a bundle_header, num_entries bundle_entry records, then the data of every
+// entry (each starting on a BUNDLE_ALIGNMENT boundary). Images are stored as
+// RGBA32 pixels (width * height * 4 bytes), sounds as PCM samples in the
+// header's sound format, so nothing has to be decoded when the game starts.
+#define ASSET_BUNDLE_PATH "Debug/assets.bundle"
+#define BUNDLE_MAGIC "PNDMBNDL"
+#define BUNDLE_VERSION 1
+#define BUNDLE_NAME_LENGTH 48
+#define BUNDLE_ALIGNMENT 16
+
+enum bundle_entry_type
+{
+    BUNDLEENTRY_IMAGE,
+    BUNDLEENTRY_SOUND
+};
+
+struct bundle_header
+{
+    char magic[8];
+    Uint32 version;
+    Uint32 num_entries;
+    Uint32 sound_frequency;
+    Uint16 sound_format;
+    Uint16 sound_channels;
+};
+
+struct bundle_entry
+{
+    // file name as listed in texture_file_names or sound_file_names (zero padded)
+    char name[BUNDLE_NAME_LENGTH];
+    Uint32 type;
+    Uint32 width;
+    Uint32 height;
+    Uint32 reserved;
+    Uint64 offset;
+    Uint64 size;
+};
+
+// A bundle file mapped into memory (read only). Entry data points into the
+// mapping, so it is valid until the bundle is closed.
+class asset_bundle
+{
+    public:
+        asset_bundle();
+        ~asset_bundle();
+        bool open(std::string);
+        void close();
+        bool isOpen();
+        bool hasSoundFormat(int, Uint16, int);
+        const bundle_entry *findEntry(std::string, bundle_entry_type);
+        const Uint8 *getEntryData(const bundle_entry *);
+    private:
+        const Uint8 *data;
+        Uint64 data_size;
+        const bundle_header *header;
+        const bundle_entry *entries;
+        // platform handles of the mapping (a file descriptor is closed right after mapping)
+        void *file_handle;
+        void *mapping_handle;
+        bool checkIndex();
+};
+
+#endif
@@ -25,8 +25,8 @@ void entity::setEntityFields(point l, point d, int tid, int eid)
     textureDim = dim;
     entity_id = eid;
     texture_index = tid;
-    center = getMidpoint(loc,addPoints(loc,dim));
-    max_loc = addPoints(loc,dim);
+    center = getMidpoint(loc,loc + dim);
+    max_loc = loc + dim;
 }
 
 point entity::getLoc()
@@ -93,12 +93,12 @@ void entity::setLoc(point l)
 
 void entity::setCenter()
 {
-    center = getMidpoint(loc,addPoints(loc,dim));
+    center = getMidpoint(loc,loc + dim);
 }
 
 void entity::setMaxLoc()
 {
-    max_loc = addPoints(loc,dim);
+    max_loc = loc + dim;
 }
 
 static_entity::static_entity()
@@ -211,7 +211,7 @@ void dynamic_entity::setVelocity(point new_vel)
 
 void dynamic_entity::incVelocity(point summand)
 {
-    velocity = addPoints(velocity,summand);
+    velocity = velocity + summand;
     limitVelocity();
 }
 
@@ -272,7 +272,7 @@ void dynamic_entity::setMarkForDeletion()
 
 void dynamic_entity::incLoc(point l)
 {
-    loc = addPoints(loc,l);
+    loc = loc + l;
     setCenter();
     setMaxLoc();
 }
@@ -421,6 +421,9 @@ item::item()
     hold_timer = 0;
     can_use = true;
     wm_type = WEAPONMODIFIER_NONE;
+    archetype = ITEMTYPE_NONE;
+    stat_delta.wep_stats = item_data[(int)archetype].iisf.wep_stats;
+    stat_delta.usability_speed = item_data[(int)archetype].iisf.usability_speed;
 }
 
 int item::getPossessionMobID()
@@ -443,10 +446,12 @@ void item::setUsability(bool u)
     can_use = u;
 }
 
-void item::setItemFields(initial_item_fields iif, point pos, int id)
+void item::setItemFields(item_type i_type, point pos, int id)
 {
-    setDynamicEntityFields(iif.idef,pos,id);
-    ii_sfields = iif.iisf;
+    setDynamicEntityFields(item_data[(int)i_type].idef,pos,id);
+    archetype = i_type;
+    stat_delta.wep_stats = item_data[(int)i_type].iisf.wep_stats;
+    stat_delta.usability_speed = item_data[(int)i_type].iisf.usability_speed;
     reset_frame_when_done = true;
     setXDeltaNormal(0.0);
     wm_type = WEAPONMODIFIER_NONE;
@@ -458,10 +463,10 @@ void item::setWeaponModifierType(weaponmodifier_type wmt)
 
     if (wm_type == WEAPONMODIFIER_FAST || wm_type == WEAPONMODIFIER_FASTDAMAGING)
     {
-        ii_sfields.usability_speed /= 2;
+        stat_delta.usability_speed /= 2;
 
-        if (ii_sfields.usability_speed < 1)
-            ii_sfields.usability_speed = 1;
+        if (stat_delta.usability_speed < 1)
+            stat_delta.usability_speed = 1;
 
         if (animation_speed > 1)
             animation_speed /= 2;
@@ -469,10 +474,10 @@ void item::setWeaponModifierType(weaponmodifier_type wmt)
 
     if (wm_type == WEAPONMODIFIER_DAMAGING || wm_type == WEAPONMODIFIER_FASTDAMAGING)
     {
-        ii_sfields.wep_stats.hp_decrement *= 2;
+        stat_delta.wep_stats.hp_decrement *= 2;
 
-        if (ii_sfields.wep_stats.knock_back > 0.0)
-            ii_sfields.wep_stats.knock_back *= 2.0;
+        if (stat_delta.wep_stats.knock_back > 0.0)
+            stat_delta.wep_stats.knock_back *= 2.0;
     }
 }
 
@@ -481,7 +486,7 @@ void item::incUsageTimer()
     if (!can_use)
     {
         usage_timer++;
-        if (usage_timer % ii_sfields.usability_speed == 0)
+        if (usage_timer % stat_delta.usability_speed == 0)
             usage_timer = 0;
         if (usage_timer == 0)
             can_use = true;
@@ -507,12 +512,12 @@ void item::setPossessionMobID(int mid)
 
 item_type item::getItemType()
 {
-    return ii_sfields.i_type;
+    return archetype;
 }
 
 item_category item::getItemCategory()
 {
-    return ii_sfields.i_category;
+    return item_data[(int)archetype].iisf.i_category;
 }
 
 weaponmodifier_type item::getWeaponModifierType()
@@ -520,9 +525,20 @@ weaponmodifier_type item::getWeaponModifierType()
     return wm_type;
 }
 
-initial_item_super_fields * item::getItemSuperFields()
+// shared stats of this item's type (see getWeaponStats and getUsabilitySpeed for the per-item ones)
+const initial_item_super_fields * item::getItemSuperFields()
 {
-    return &ii_sfields;
+    return &item_data[(int)archetype].iisf;
+}
+
+const initial_weapon_fields * item::getWeaponStats()
+{
+    return &stat_delta.wep_stats;
+}
+
+int item::getUsabilitySpeed()
+{
+    return stat_delta.usability_speed;
 }
 
 mob::mob()
@@ -541,6 +557,10 @@ mob::mob()
     name = "";
     mob_death_type = MOBDEATHTYPE_NONE;
     burningCounter = 0;
+    archetype = MOB_PLAYER;
+    stat_delta.max_hp = mob_data[(int)archetype].imsf.max_hp;
+    stat_delta.base_exp_worth = mob_data[(int)archetype].imsf.base_exp_worth;
+    stat_delta.melee_damage = mob_data[(int)archetype].imsf.melee_damage;
 }
 
 mobmodifier_type mob::getMobModifierType()
@@ -583,14 +603,14 @@ void mob::setMobModifierType(mobmodifier_type mmt)
 
     if (mm_type == MOBMODIFIER_FASTTOUGH || mm_type == MOBMODIFIER_TOUGH)
     {
-        im_sfields.base_exp_worth *= 5;
-        im_sfields.max_hp *= 2;
-        hitpoints = im_sfields.max_hp;
+        stat_delta.base_exp_worth *= 5;
+        stat_delta.max_hp *= 2;
+        hitpoints = stat_delta.max_hp;
     }
 
     if (mm_type == MOBMODIFIER_FASTTOUGH || mm_type == MOBMODIFIER_FAST)
     {
-        im_sfields.base_exp_worth *= 5;
+        stat_delta.base_exp_worth *= 5;
         max_velocity.setx(max_velocity.x()*2.0);
     }
 }
@@ -600,11 +620,14 @@ void mob::setAggroStatus(bool agg)
     aggroed = agg;
 }
 
-void mob::setMobFields(initial_mob_fields imf, point pos, int id, double x_delta_start)
+void mob::setMobFields(mob_type m_type, point pos, int id, double x_delta_start)
 {
-    setDynamicEntityFields(imf.idef,pos,id);
-    im_sfields = imf.imsf;
-    setHP(imf.imsf.max_hp);
+    setDynamicEntityFields(mob_data[(int)m_type].idef,pos,id);
+    archetype = m_type;
+    stat_delta.max_hp = mob_data[(int)m_type].imsf.max_hp;
+    stat_delta.base_exp_worth = mob_data[(int)m_type].imsf.base_exp_worth;
+    stat_delta.melee_damage = mob_data[(int)m_type].imsf.melee_damage;
+    setHP(stat_delta.max_hp);
     reset_frame_when_done = false;
     setXDeltaNormal(x_delta_start);
     mm_type = MOBMODIFIER_NONE;
@@ -618,8 +641,8 @@ void mob::setHP(int hp)
 void mob::incHP(int hp)
 {
     hitpoints += hp;
-    if (hitpoints > im_sfields.max_hp)
-        hitpoints = im_sfields.max_hp;
+    if (hitpoints > stat_delta.max_hp)
+        hitpoints = stat_delta.max_hp;
 }
 
 void mob::setDangerLevel(int dl)
@@ -633,15 +656,15 @@ void mob::setDangerLevel(int dl)
 
     if (dangerLevel > 1) {
         if (getMobType() != MOB_EXECUTIONER)
-            dim = multPoints(point(sizeScaling,sizeScaling), dim);
+            dim = point(sizeScaling,sizeScaling) * dim;
         else
-            dim = multPoints(point(1,sizeScaling), dim);
+            dim = point(1,sizeScaling) * dim;
         dim = point(floor(dim.x()),floor(dim.y()));
         setLoc(loc);
-        setMaxHP(im_sfields.max_hp + 50.0*(dl - 1));
-        setHP(im_sfields.max_hp);
-        im_sfields.base_exp_worth += ((im_sfields.base_exp_worth/3) * (dl-1));
-        im_sfields.melee_damage += 10 * (dl - 1);
+        setMaxHP(stat_delta.max_hp + 50.0*(dl - 1));
+        setHP(stat_delta.max_hp);
+        stat_delta.base_exp_worth += ((stat_delta.base_exp_worth/3) * (dl-1));
+        stat_delta.melee_damage += 10 * (dl - 1);
     }
 }
 
@@ -695,7 +718,7 @@ int mob::getHP()
 
 mob_type mob::getMobType()
 {
-    return im_sfields.m_type;
+    return archetype;
 }
 
 move_type mob::getMoveStatus()
@@ -707,9 +730,25 @@ MobDeathType mob::getMobDeathType() {
     return mob_death_type;
 }
 
-initial_mob_super_fields * mob::getMobSuperFields()
+// shared stats of this mob's type (see getMaxHP, getExpWorth and getMeleeDamage for the per-mob ones)
+const initial_mob_super_fields * mob::getMobSuperFields()
+{
+    return &mob_data[(int)archetype].imsf;
+}
+
+int mob::getMaxHP()
 {
-    return &im_sfields;
+    return stat_delta.max_hp;
+}
+
+int mob::getExpWorth()
+{
+    return stat_delta.base_exp_worth;
+}
+
+int mob::getMeleeDamage()
+{
+    return stat_delta.melee_damage;
 }
 
 void mob::incTilt()
@@ -741,7 +780,7 @@ bool mob::dropsKey()
 
 void mob::setMaxHP(int nmhp)
 {
-    im_sfields.max_hp = nmhp;
+    stat_delta.max_hp = nmhp;
 }
 
 void mob::setKeyDropFlag(bool kdf)
@@ -754,7 +793,7 @@ void mob::setName(std::string n)
     name = n;
 }
 
-std::string mob::getName()
+const std::string &mob::getName()
 {
     return name;
 }
@@ -823,8 +862,8 @@ double door::useSpeed()
 void door::changeLoc(point l)
 {
     loc = l;
-    center = getMidpoint(loc,addPoints(loc,dim));
-    max_loc = addPoints(loc,dim);
+    center = getMidpoint(loc,loc + dim);
+    max_loc = loc + dim;
 }
 
 void door::setDoorState(door_state ds)
@@ -838,7 +877,7 @@ void door::setDoorFields(point l, point sze, int tid, int eid, door_state ds, do
 
     current_state = ds;
     use_speed = uspd;
-    opened_loc = addPoints(loc,point(0.0,-1.0*sze.y()));
+    opened_loc = loc + point(0.0,-1.0*sze.y());
     closed_loc = loc;
 
     if (current_state == DOORSTATE_CLOSED)
@@ -918,6 +957,13 @@ bool collisionWithEntity(point center, point dim, entity *ent)
                                  ent->getMaxLoc().y() + (dim.y() / 2.0)));
 }
 
+// Does "ent" overlap the area minp..maxp (with a pixel to spare for rounding)?
+bool isEntityInArea(entity *ent, point minp, point maxp)
+{
+    return ent->getLoc().x() <= maxp.x() + 1.0 && ent->getLoc().y() <= maxp.y() + 1.0 &&
+           ent->getMaxLoc().x() >= minp.x() - 1.0 && ent->getMaxLoc().y() >= minp.y() - 1.0;
+}
+
 void checkMarkForDeletion(dynamic_entity *de) {
      if (de->destroyUponCollision())
          de->setMarkForDeletion();
@@ -996,8 +1042,8 @@ void Ladder::setLadderFeatures(point l, point size, point blockSize, int eID, SD
             break;
     }
 
-    center = getMidpoint(loc,addPoints(loc, dim));
-    max_loc = addPoints(loc,dim);
+    center = getMidpoint(loc,loc + dim);
+    max_loc = loc + dim;
 }
 
 int getLadderTexture(LadderType ladderType) {
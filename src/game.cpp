@@ -4,12 +4,40 @@
 #include "game.h"
 
 Game::Game() {
+    broadphase_dirty = true;
+    static_layers_dirty = true;
+    static_layers_baked = false;
+    num_deleted_entities = 0;
+    num_level_allocations = 0;
+    level_load_start_allocations = 0;
+    assets_ready = assets_loaded = false;
+    textures_from_bundle = sounds_from_bundle = false;
+    startup_counter = 0;
+    startup_sdl_ms = startup_mixer_ms = startup_bundle_ms = startup_upload_ms = startup_menu_ms = 0.0;
+    props.init(MAX_GIB_PROPS);
+    setRandomNumberGenerator(&rng_engine);
+    setSeed((unsigned int)time(0));
     initGameStats();
 }
 
+void Game::setSeed(unsigned int seed) {
+    game_seed = seed;
+    reseed();
+}
+
+unsigned int Game::getSeed() {
+    return game_seed;
+}
+
+// Restart the random number sequence from the current seed.
+// Called at the start of every new game so the same seed gives the same game.
+void Game::reseed() {
+    rng_engine.seed(game_seed);
+}
+
 void Game::initLevelMapSize(int level) {
     point size = level_map_sizes[level - 1];
-    current_level_size = multPoints(size, point(SMALL_BLOCK_DIM,SMALL_BLOCK_DIM));
+    current_level_size = size * point(SMALL_BLOCK_DIM,SMALL_BLOCK_DIM);
 }
 
 void Game::initGameStats() {
@@ -90,9 +118,9 @@ void Game::checkWeaponExpLevels() {
 void Game::levelUpPlayer() {
     exp_level++;
     // The player should have 1.05 times the previous amount of hitpoints had for each levelup
-    getPlayerMob()->setMaxHP((int)((double)getPlayerMob()->getMobSuperFields()->max_hp*(1.05)) + randInt(0,exp_level));
+    getPlayerMob()->setMaxHP((int)((double)getPlayerMob()->getMaxHP()*(1.05)) + randInt(0,exp_level));
     // The player's hitpoints should be reset to maximum if at least one levelup is performed
-    getPlayerMob()->setHP(getPlayerMob()->getMobSuperFields()->max_hp);
+    getPlayerMob()->setHP(getPlayerMob()->getMaxHP());
     // Play level up sound
     sfx.playSoundEffect(sfx.getSoundEffect((int)SOUNDTYPE_LEVELUP));
 }
@@ -124,7 +152,7 @@ void Game::displayMenu(menu *mu)
                 mu->getLoc().y()+mu->getArea().y() + i*FONT_CHAR_HEIGHT);
         gfx.addBitmapString(color_white,mu->getMenuItem(i),loc);
         if (mu->getSelectionIndex() == i)
-            gfx.addBitmapCharacter(color_white,26,addPoints(loc,point(-FONT_CHAR_HEIGHT*2.0,0.0)));
+            gfx.addBitmapCharacter(color_white,26,loc + point(-FONT_CHAR_HEIGHT*2.0,0.0));
     }
 }
 
@@ -132,9 +160,13 @@ void Game::displayMenu(menu *mu)
 void Game::traverseMainMenu(bool reset)
 {
     bool exit_main_menu = false;
+    char seed_text[MAX_TEXT_RUN_LENGTH + 1];
     do {
         frame_start_timer = SDL_GetTicks();
+        // build the texture atlases and take the sounds as soon as they are all decoded
+        finishAssetLoading(false);
         evt_handler.processKey();
+        checkRendererReset();
 
         if (main_menu.canChangeSelection())
         if (evt_handler.deltaKeyPressed()) {
@@ -142,6 +174,12 @@ void Game::traverseMainMenu(bool reset)
             main_menu.setSelectionChangeFlag(false);
         }
 
+        // +/- change the seed of the next new game
+        if (evt_handler.plusKeyPressed())
+            game_seed++;
+        if (evt_handler.minusKeyPressed())
+            game_seed--;
+
         if (evt_handler.selectKeyPressed()) {
             exit_main_menu = true;
             if (main_menu.getSelectionIndex() == 3)
@@ -153,30 +191,35 @@ void Game::traverseMainMenu(bool reset)
         main_menu.activateSelectionChangeTimer();
 
         gfx.clearScreen();
-        gfx.renderSprite(gfx.getTexture(59),main_menu.getLoc(),main_menu.getArea(),main_menu.getArea(),0,0,SDL_FLIP_NONE,true,color_black,2);
+        gfx.renderSprite(gfx.getTexture(MENU_BACKDROP_TEXTURE),main_menu.getLoc(),main_menu.getArea(),main_menu.getArea(),0,0,SDL_FLIP_NONE,true,color_black,2);
+        gfx.setSpriteLayer(SPRITELAYER_HUD);
         displayMenu(&main_menu);
         gfx.addBitmapString(color_white,"Copyright Eric Wolfson 2016-2017",point((double)WINDOW_WIDTH/3.0 - 60.0,(double)WINDOW_HEIGHT - 200.0));
+        snprintf(seed_text,sizeof(seed_text),"Seed: %u (+/- to change)",game_seed);
+        gfx.addBitmapString(color_white,seed_text,point((double)WINDOW_WIDTH/3.0 - 60.0,(double)WINDOW_HEIGHT - 180.0));
         gfx.updateScreen();
         delayGame();
     } while(!exit_main_menu);
 }
 
 // Build map's maze layout
+// (level_generator keeps its storage, so after the largest map it doesn't allocate)
 void Game::generateMap() {
-    terrain_map t_generator;
-    t_generator.createTerrainMap(level_map_sizes[(int)std::min(9,current_level - 1)],
-                                 point(SMALL_BLOCK_DIM,SMALL_BLOCK_DIM),current_level);
+    level_generator.createTerrainMap(level_map_sizes[(int)std::min(9,current_level - 1)],
+                                     point(SMALL_BLOCK_DIM,SMALL_BLOCK_DIM),current_level);
     point mloc = point(0.0,0.0);
-    point bsze = t_generator.getBlockSize();
+    point bsze = level_generator.getBlockSize();
     point aloc;
     point asze;
     int tid = 0;
-    for (int y = 0; y < t_generator.getDim().y(); ++y) {
-        for (int x = 0; x < t_generator.getDim().x(); ++x) {
-            tid = t_generator.getTerrainStruct(point(x,y)).tid;
-            asze = t_generator.getTerrainStruct(point(x,y)).sze;
+    terrain_struct ts;
+    for (int y = 0; y < level_generator.getDim().y(); ++y) {
+        for (int x = 0; x < level_generator.getDim().x(); ++x) {
+            ts = level_generator.getTerrainStruct(point(x,y));
+            tid = ts.tid;
+            asze = ts.sze;
             aloc = point(mloc.x()+(x*bsze.x()),mloc.y()+(y*bsze.y()));
-            switch(t_generator.getTerrainStruct(point(x,y)).t_type) {
+            switch(ts.t_type) {
                 case(TERRAINTYPE_WALL):
                      addWallBlockAtLocation(aloc,asze,tid);
                      break;
@@ -218,9 +261,9 @@ void Game::generateMap() {
             }
         }
     }
-    t_generator.cleanupTerrainMap();
-    start_loc = multPoints(t_generator.getStartBlock(),point(40.0,40.0));
-    start_loc = addPoints(start_loc, point(10.0,1.0));
+    start_loc = level_generator.getStartBlock() * point(40.0,40.0);
+    start_loc = start_loc + point(10.0,1.0);
+    buildStaticBlockerGrid();
 }
 
 // Add NPC to npc vector
@@ -230,16 +273,20 @@ void Game::generateMap() {
 void Game::addNPC(mob_type m_type, item_type i_type, point loc, double x_delta)
 {
     npcs.push_back(mob());
+    markBroadphaseDirty();
     npcIDCounter++;
     int index = (int)npcs.size() - 1;
     int default_hp = mob_data[(int)m_type].imsf.max_hp;
-    npcs[index].setMobFields(mob_data[(int)m_type],loc,npcIDCounter,x_delta);
+    npcs[index].setMobFields(m_type,loc,npcIDCounter,x_delta);
+    if ((int)npc_index_from_id.size() <= npcIDCounter)
+        npc_index_from_id.resize(npcIDCounter + 1,-1);
+    npc_index_from_id[npcIDCounter] = index;
     npcs[index].setMobModifierType(MOBMODIFIER_NONE);
     npcs[index].setName("");
     if (current_level > 19)
     {
-        npcs[index].setMaxHP(npcs[index].getMobSuperFields()->max_hp + (current_level - 15));
-        npcs[index].setHP(npcs[index].getMobSuperFields()->max_hp);
+        npcs[index].setMaxHP(npcs[index].getMaxHP() + (current_level - 15));
+        npcs[index].setHP(npcs[index].getMaxHP());
     }
     if (rollPerc(current_level))
     {
@@ -285,12 +332,13 @@ bool Game::isBoss(mob_type mt)
 void Game::addItem(item_type i_type, point loc, bool can_be_modified)
 {
     items.push_back(item());
+    markBroadphaseDirty();
     int index = (int)items.size() - 1;
     point dim = item_data[(int)i_type].idef.dimensions;
-    point aloc = addPoints(loc,multPoints(dim,point(-0.5,-0.5)));
-    aloc = addPoints(aloc,point(20.0,20.0));
+    point aloc = loc + dim * point(-0.5,-0.5);
+    aloc = aloc + point(20.0,20.0);
     aloc.sety(loc.y()+40.0-dim.y());
-    items[index].setItemFields(item_data[(int)i_type],aloc,index);
+    items[index].setItemFields(i_type,aloc,index);
     items[index].setWeaponModifierType(WEAPONMODIFIER_NONE);
     if (rollPerc((current_level/2 + 1)) && can_be_modified)
     {
@@ -315,12 +363,13 @@ void Game::addItem(item_type i_type, point loc, bool can_be_modified)
 void Game::addPowerup(item_type i_type, point loc)
 {
     powerups.push_back(item());
+    markBroadphaseDirty();
     int index = (int)powerups.size() - 1;
     point dim = item_data[(int)i_type].idef.dimensions;
-    point aloc = addPoints(loc,multPoints(dim,point(-0.5,-0.5)));
-    aloc = addPoints(aloc,point(20.0,20.0));
+    point aloc = loc + dim * point(-0.5,-0.5);
+    aloc = aloc + point(20.0,20.0);
     aloc.sety(loc.y()+40.0-dim.y());
-    powerups[index].setItemFields(item_data[(int)i_type],aloc,index);
+    powerups[index].setItemFields(i_type,aloc,index);
 }
 
 // Add wall block
@@ -398,6 +447,8 @@ void Game::addDoorAtLocation(point loc, point bsize, point sze, int tid, bool lo
 
 // Initialize everything on level
 void Game::initLevelObjects() {
+    beginLevelLoad();
+
     npcTargetFocusID = -1;
     // set level colors
     setWallColorTint();
@@ -419,12 +470,13 @@ void Game::initLevelObjects() {
 
     // create map wall layout, doors, powerups, items, exit, etc...
     generateMap();
+    markStaticLayersDirty();
 
     // Put player at bottom right, or bottom left of level to start.
     if (roll(2))
     {
         if (current_level == 1)
-            player_mob.setMobFields(mob_data[(int)MOB_PLAYER],point(45.0,MAP_HEIGHT-82.0),0,1.0);
+            player_mob.setMobFields(MOB_PLAYER,point(45.0,MAP_HEIGHT-82.0),0,1.0);
         else
             player_mob.setLoc(point(45.0,MAP_HEIGHT-82.0));
 
@@ -434,7 +486,7 @@ void Game::initLevelObjects() {
     else
     {
         if (current_level == 1)
-            player_mob.setMobFields(mob_data[(int)MOB_PLAYER],point(MAP_WIDTH-63.0,MAP_HEIGHT-82.0),0,-1.0);
+            player_mob.setMobFields(MOB_PLAYER,point(MAP_WIDTH-63.0,MAP_HEIGHT-82.0),0,-1.0);
         else
             player_mob.setLoc(point(MAP_WIDTH-63.0,MAP_HEIGHT-82.0));
 
@@ -462,6 +514,8 @@ void Game::initLevelObjects() {
     setGlobalTint(false);
 
     settleMobsToGround();
+
+    endLevelLoad();
 }
 
 void Game::setGlobalTint(bool tinted)
@@ -469,6 +523,8 @@ void Game::setGlobalTint(bool tinted)
     if (current_level <= BOSS_LEVEL3 && tinted)
         return;
 
+    markStaticLayersDirty();
+
     for (int i = 0; i < NUM_TIMESTOPPED_COLOR_VARIATION; ++i)
     {
          global_tint[i] = (tinted ? time_stopped_colors[i] : color_black);
@@ -495,11 +551,11 @@ void Game::genOneNPC(mob_type m_type, bool spawn_npc)
         else
             occur_loc = point((double)randInt(80.0,MAP_WIDTH-120.0),(double)randInt(80.0,MAP_HEIGHT-160.0));
         occur_dim = mob_data[(int)m_type].idef.dimensions;
-        occur_center = addPoints(occur_loc,multPoints(occur_dim,point(0.5,0.5)));
+        occur_center = occur_loc + occur_dim * point(0.5,0.5);
     }while((isCollidingWithStaticBlocker(occur_center,occur_dim) && m_type != MOB_SHADOW && m_type != MOB_SHADOWKING) || distanceLongestAxis(occur_loc,player_mob.getLoc()) <= min_dist);
     // add it in (with possible spawn particle)
     if (spawn_npc)
-        addSpawnParticle(addPoints(occur_center,point(-13.0,-13.0)));
+        addSpawnParticle(occur_center + point(-13.0,-13.0));
     // The last parameter represents starting x-orientation
     addNPC(m_type,getStartingWeaponForMob(m_type),occur_loc,-1.0 + (double)(2 * randZero(1)));
     if (m_type == MOB_SOLDIER || m_type == MOB_CAPTAIN) {
@@ -531,14 +587,15 @@ void Game::mobTeleport(mob *mb) {
 
     occur_loc = point((double)randInt(80.0,MAP_WIDTH-120.0),(double)randInt(80.0,MAP_HEIGHT-120.0));
     occur_dim = mob_data[(int)mb->getMobType()].idef.dimensions;
-    occur_center = addPoints(occur_loc,multPoints(occur_dim,point(0.5,0.5)));
+    occur_center = occur_loc + occur_dim * point(0.5,0.5);
 
     if (!isCollidingWithStaticBlocker(occur_center,occur_dim)) {
-        addSpawnParticle(addPoints(mb->getCenter(),point(-13.0,-13.0)));
+        addSpawnParticle(mb->getCenter() + point(-13.0,-13.0));
 
         mb->setLoc(occur_loc);
+        markBroadphaseDirty();
 
-        addSpawnParticle(addPoints(occur_center,point(-13.0,-13.0)));
+        addSpawnParticle(occur_center + point(-13.0,-13.0));
     }
 }
 
@@ -598,12 +655,91 @@ item_type Game::getRandItem(int start_val, int end_val) {
     return ret_val;
 }
 
+static double getElapsedMs(Uint64 start_counter)
+{
+    return (double)(SDL_GetPerformanceCounter() - start_counter) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// Initialize graphics and sound, and load textures and sounds from the asset bundle.
+// Without a (complete) bundle, the loose files are decoded instead: only the font and
+// the menu backdrop are waited for, so the main menu is shown while the rest is decoded.
+bool Game::startEngines() {
+    startup_counter = SDL_GetPerformanceCounter();
+
+    Uint64 step_counter = SDL_GetPerformanceCounter();
+    if (!gfx.initSDL())
+        return false;
+    startup_sdl_ms = getElapsedMs(step_counter);
+
+    step_counter = SDL_GetPerformanceCounter();
+    if (!sfx.initMixer())
+        return false;
+    startup_mixer_ms = getElapsedMs(step_counter);
+
+    step_counter = SDL_GetPerformanceCounter();
+    if (bundle.open(ASSET_BUNDLE_PATH)) {
+        textures_from_bundle = gfx.loadTexturesFromBundle(&bundle);
+        sounds_from_bundle = sfx.loadSoundsFromBundle(&bundle);
+        if (!textures_from_bundle || !sounds_from_bundle)
+            std::cout << "Asset bundle is incomplete, the rest is loaded from loose files\n";
+        // texture pixels were copied into the atlases, only sounds use the mapping
+        if (!sounds_from_bundle)
+            bundle.close();
+    }
+    startup_bundle_ms = getElapsedMs(step_counter);
+
+    if (!textures_from_bundle)
+        gfx.queueTextureDecoding(&asset_pool);
+    if (!sounds_from_bundle)
+        sfx.queueSoundDecoding(&asset_pool);
+    asset_pool.start();
+
+    if (!textures_from_bundle &&
+        (!gfx.loadEarlyTexture(&asset_pool,FONT_ATLAS_IMAGE) || !gfx.loadEarlyTexture(&asset_pool,MENU_BACKDROP_TEXTURE)))
+        return false;
+    startup_menu_ms = getElapsedMs(startup_counter);
+
+    return true;
+}
+
+// Once every file is decoded (right away if wait is set), upload the texture atlases
+// and take the sounds. Returns false if an asset failed to load.
+bool Game::finishAssetLoading(bool wait) {
+    if (!assets_ready && (wait || asset_pool.isFinished())) {
+        asset_pool.waitForAll();
+        Uint64 step_counter = SDL_GetPerformanceCounter();
+        assets_loaded = (textures_from_bundle || gfx.buildTextureAtlases(&asset_pool)) &&
+                        (sounds_from_bundle || sfx.loadSounds(&asset_pool));
+        startup_upload_ms = getElapsedMs(step_counter);
+        assets_ready = true;
+        printStartupTimes();
+    }
+    return !assets_ready || assets_loaded;
+}
+
+void Game::printStartupTimes() {
+    std::cout << "Startup: sdl init " << startup_sdl_ms << " ms, mixer " << startup_mixer_ms << " ms, bundle "
+              << startup_bundle_ms << " ms (textures " << (textures_from_bundle ? "yes" : "no") << ", sounds "
+              << (sounds_from_bundle ? "yes" : "no") << "), decode "
+              << asset_pool.getDecodeTime() << " ms (" << asset_pool.getWorkTime() << " ms of work on "
+              << asset_pool.getNumThreads() << " threads), upload " << startup_upload_ms << " ms\n";
+    std::cout << "Startup: main menu after " << startup_menu_ms << " ms, all assets after "
+              << getElapsedMs(startup_counter) << " ms\n";
+}
+
 // function called from main.cpp
 void Game::run() {
     // initialize graphics and sound
-    if(gfx.initSDL() && sfx.initMixer()) {
+    if(startEngines()) {
         initMainMenu(false);
         traverseMainMenu(false);
+        if (!finishAssetLoading(true)) {
+            std::cout << "Failed to load assets... press enter to terminate.";
+            std::cin.get();
+            return;
+        }
+        std::cout << "Seed: " << game_seed << "\n";
+        reseed();
         initLevelObjects();
         primaryGameLoop();
     }
@@ -619,18 +755,57 @@ void Game::run() {
 
 // Clear every level entity.
 // Called when a new level needs to be constructed.
+// The containers keep their storage, so the next level is built without allocating.
 void Game::cleanupLevelData() {
-    std::vector<entity>().swap(backdrops);
-    std::vector<static_entity>().swap(walls);
-    std::vector<static_entity>().swap(static_props);
-    std::vector<Ladder>().swap(ladders);
-    std::vector<toggle_switch>().swap(switches);
-    std::vector<door>().swap(doors);
-    std::vector<mob>().swap(npcs);
-    std::vector<item>().swap(items);
-    std::vector<item>().swap(powerups);
-    std::vector<dynamic_entity>().swap(props);
-    std::vector<particle>().swap(particles);
+    backdrops.clear();
+    walls.clear();
+    wall_rects.clear();
+    static_props.clear();
+    ladders.clear();
+    switches.clear();
+    doors.clear();
+    npcs.clear();
+    items.clear();
+    powerups.clear();
+    props.clear();
+    particles.clear();
+    npc_index_from_id.clear();
+    wall_grid.clear();
+    wall_rect_grid.clear();
+    door_grid.clear();
+    markBroadphaseDirty();
+}
+
+// Reserve room for everything the current level can create.
+// A maze cell holds at most one wall, ladder or backdrop; doors, items
+// and powerups are far sparser (one per 16 cells is more than any level uses).
+void Game::reserveLevelStorage() {
+    point map_size = level_map_sizes[(int)std::min(9,current_level - 1)];
+    int num_cells = (int)(map_size.x() * map_size.y());
+    int max_npcs = max_npc_vector_size[std::min(10,current_level)-1];
+
+    backdrops.reserve(num_cells + 1);
+    walls.reserve(num_cells + 4);
+    wall_rects.reserve(num_cells + 4);
+    static_props.reserve(num_cells/16 + 1);
+    ladders.reserve(num_cells);
+    switches.reserve(2 * (num_cells/16));
+    doors.reserve(num_cells/16);
+    npcs.reserve(max_npcs);
+    items.reserve(max_npcs + num_cells/16);
+    powerups.reserve(num_cells/16);
+    npc_index_from_id.reserve(max_npcs + 1);
+}
+
+// Call before building a level (after cleanupLevelData)
+void Game::beginLevelLoad() {
+    level_load_start_allocations = getThreadAllocationCount();
+    reserveLevelStorage();
+}
+
+// Count the heap allocations made since beginLevelLoad (reserving included).
+void Game::endLevelLoad() {
+    num_level_allocations = (int)(getThreadAllocationCount() - level_load_start_allocations);
 }
 
 // Apply time stop flag changes
@@ -656,8 +831,7 @@ void Game::toggleTime()
     for (int i = 0; i < (int)items.size(); ++i)
          items[i].togglePhysics(eitherFromPlayerOrTimeActive(items[i].getPossessionMobID()) ? PHYSTYPE_FULL : PHYSTYPE_OFF);
 
-    for (int i = 0; i < (int)props.size(); ++i)
-         props[i].togglePhysics(miscphys);
+    props.setPhysicsStatus(miscphys);
 
     for (int i = 0; i < (int)particles.size(); ++i)
          particles[i].togglePhysics(miscphys);
@@ -697,7 +871,7 @@ void Game::createShadowExplosions(mob *mb)
 {
     point loc;
     loc = point(randInt(0,100),(randInt(0,100)));
-    addSpawnParticle(addPoints(mb->getCenter(),point(-63.0+loc.x(),-63.0+loc.y())));
+    addSpawnParticle(mb->getCenter() + point(-63.0+loc.x(),-63.0+loc.y()));
     if (roll(15))
         squirtDynamicGibParticles(mb, mob_death_gib_count[getAdjustedMobIndex(mb)].large_blood_killed_gibs, PROP_LARGEBLOOD);
     if (roll(10))
@@ -705,26 +879,188 @@ void Game::createShadowExplosions(mob *mb)
 }
 
 bool Game::isCollidingWithStaticBlocker(point center, point dim) {
-    for (auto it = walls.begin(); it != walls.end(); ++it) {
-        if (collisionWithEntity(center, dim, &*it))
-            return true;
-    }
+    point minp = point(center.x() - dim.x()/2.0 - 1.0, center.y() - dim.y()/2.0 - 1.0);
+    point maxp = point(center.x() + dim.x()/2.0 + 1.0, center.y() + dim.y()/2.0 + 1.0);
+
+    if (isCollidingWithWallRect(center, dim))
+        return true;
 
-    for (auto it = doors.begin(); it != doors.end(); ++it) {
-	if (collisionWithEntity(center, dim, &*it))
-	    return true;
+    door_grid.query(minp, maxp, blocker_candidates);
+    for (int i = 0; i < (int)blocker_candidates.size(); ++i) {
+        if (collisionWithEntity(center, dim, &doors[blocker_candidates[i]]))
+            return true;
     }
 
     return false;
 }
 
 // Check if dynamic object "de" is colliding with a static blocking object (wall or door)
+// Only walls and doors in the tiles around "de" are checked (in index order, like before).
+// restrictLoc only ever moves "de" back towards its old location (give or take 1 pixel),
+// so the box around its old and current locations covers every blocker it can touch here.
 void Game::applyCollisions(dynamic_entity *de) {
-    for (auto it = walls.begin(); it != walls.end(); ++it)
-         processDynamicEntityWallCollision(de, &*it);
+    // Walls only move "de" if it already touches one of them, and the union of the
+    // wall tiles is exactly the union of the merged rectangles. So when no rectangle
+    // is touched, the per tile pass below would not do anything.
+    bool touching_wall = isCollidingWithWallRect(de->getCenter(), de->getDim());
+
+    point old_max_loc = de->getOldLoc() + de->getDim();
+    point minp = point(std::min(de->getLoc().x(), de->getOldLoc().x()) - 2.0,
+                       std::min(de->getLoc().y(), de->getOldLoc().y()) - 2.0);
+    point maxp = point(std::max(de->getMaxLoc().x(), old_max_loc.x()) + 2.0,
+                       std::max(de->getMaxLoc().y(), old_max_loc.y()) + 2.0);
+
+    if (touching_wall) {
+        wall_grid.query(minp, maxp, blocker_candidates);
+        for (int i = 0; i < (int)blocker_candidates.size(); ++i)
+             processDynamicEntityWallCollision(de, &walls[blocker_candidates[i]]);
+    }
+
+    door_grid.query(minp, maxp, blocker_candidates);
+    for (int i = 0; i < (int)blocker_candidates.size(); ++i)
+         processDynamicEntityDoorCollision(de, &doors[blocker_candidates[i]]);
+
+    // restrictLoc may have moved "de"
+    markBroadphaseDirty();
+}
+
+// applyCollisions for the prop in slot "slot" of the prop pool
+void Game::applyPropCollisions(int slot) {
+    point old_max_loc = props.getOldLoc(slot) + props.getDim(slot);
+    point minp = point(std::min(props.getLoc(slot).x(), props.getOldLoc(slot).x()) - 2.0,
+                       std::min(props.getLoc(slot).y(), props.getOldLoc(slot).y()) - 2.0);
+    point maxp = point(std::max(props.getMaxLoc(slot).x(), old_max_loc.x()) + 2.0,
+                       std::max(props.getMaxLoc(slot).y(), old_max_loc.y()) + 2.0);
+
+    // see applyCollisions
+    if (isCollidingWithWallRect(props.getCenter(slot), props.getDim(slot)))
+        wall_grid.query(minp, maxp, blocker_candidates);
+    else
+        blocker_candidates.clear();
+    for (int i = 0; i < (int)blocker_candidates.size(); ++i) {
+        static_entity *wl = &walls[blocker_candidates[i]];
+        if (collisionWithEntity(props.getCenter(slot), props.getDim(slot), wl)) {
+            if (props.destroyUponCollision(slot))
+                props.setMarkForDeletion(slot);
+            props.restrictProp(slot, wl->getLoc(), wl->getMaxLoc());
+        }
+    }
+
+    door_grid.query(minp, maxp, blocker_candidates);
+    for (int i = 0; i < (int)blocker_candidates.size(); ++i) {
+        door *dr = &doors[blocker_candidates[i]];
+        if (collisionWithEntity(props.getCenter(slot), props.getDim(slot), dr)) {
+            if (props.destroyUponCollision(slot))
+                props.setMarkForDeletion(slot);
+
+            if (isDoorStationary(dr->getDoorState()))
+                props.restrictProp(slot, dr->getLoc(), dr->getMaxLoc());
+            else
+                dr->setDoorState(DOORSTATE_OPENING);
+        }
+    }
+}
 
-    for (auto it = doors.begin(); it != doors.end(); ++it)
-         processDynamicEntityDoorCollision(de, &*it);
+// Call whenever an npc, item or powerup is added, removed or moved outside of applyPhysics
+void Game::markBroadphaseDirty() {
+    broadphase_dirty = true;
+}
+
+// Rebuild the npc, item and powerup hashes if anything changed since the last rebuild.
+// Called before every query, so at most once per tick in the common case.
+void Game::updateBroadphase() {
+    if (!broadphase_dirty)
+        return;
+
+    npc_hash.clear();
+    item_hash.clear();
+    powerup_hash.clear();
+
+    for (int i = 0; i < (int)npcs.size(); ++i)
+         npc_hash.insert(i, npcs[i].getLoc(), npcs[i].getMaxLoc());
+
+    for (int i = 0; i < (int)items.size(); ++i)
+         item_hash.insert(i, items[i].getLoc(), items[i].getMaxLoc());
+
+    for (int i = 0; i < (int)powerups.size(); ++i)
+         powerup_hash.insert(i, powerups[i].getLoc(), powerups[i].getMaxLoc());
+
+    broadphase_dirty = false;
+}
+
+// Greedily merge the wall tiles into rectangles: first every run of tiles that
+// touch side by side in a row (walls are added row by row, so a run is a sequence
+// of consecutive indices), then every run exactly below a rectangle of the same width.
+// The rectangles cover exactly the same area as the tiles, so they answer "is this
+// touching a wall" and bullet ray queries with far fewer entries. Tiles are kept for
+// rendering and for pushing entities out of walls (restrictLoc depends on which
+// tile edge is hit, including edges between tiles).
+void Game::mergeWallTiles() {
+    wall_rects.clear();
+
+    int i = 0;
+    while (i < (int)walls.size())
+    {
+        point run_min = walls[i].getLoc();
+        point run_max = walls[i].getMaxLoc();
+        int j = i + 1;
+        while (j < (int)walls.size() &&
+               walls[j].getLoc().y() == run_min.y() &&
+               walls[j].getMaxLoc().y() == run_max.y() &&
+               walls[j].getLoc().x() == run_max.x())
+        {
+            run_max.setx(walls[j].getMaxLoc().x());
+            j++;
+        }
+
+        bool stacked = false;
+        for (int r = (int)wall_rects.size() - 1; r >= 0 && !stacked; --r)
+        {
+            if (wall_rects[r].getMaxLoc().y() == run_min.y() &&
+                wall_rects[r].getLoc().x() == run_min.x() &&
+                wall_rects[r].getMaxLoc().x() == run_max.x())
+            {
+                wall_rects[r].setEntityFields(wall_rects[r].getLoc(),run_max - wall_rects[r].getLoc(),0,r);
+                stacked = true;
+            }
+        }
+
+        if (!stacked)
+        {
+            wall_rects.push_back(static_entity());
+            wall_rects.back().setEntityFields(run_min,run_max - run_min,0,(int)wall_rects.size() - 1);
+        }
+
+        i = j;
+    }
+}
+
+// Is a box of dimensions "dim" centered at "center" touching a wall?
+bool Game::isCollidingWithWallRect(point center, point dim) {
+    wall_rect_grid.query(center - dim * 0.5 - point(1.0,1.0), center + dim * 0.5 + point(1.0,1.0), blocker_candidates);
+    for (int i = 0; i < (int)blocker_candidates.size(); ++i) {
+        if (collisionWithEntity(center, dim, &wall_rects[blocker_candidates[i]]))
+            return true;
+    }
+    return false;
+}
+
+// Index every wall, wall rectangle and door by the map tiles it covers
+void Game::buildStaticBlockerGrid() {
+    mergeWallTiles();
+
+    wall_grid.init(current_level_size, SMALL_BLOCK_DIM);
+    wall_rect_grid.init(current_level_size, SMALL_BLOCK_DIM);
+    door_grid.init(current_level_size, SMALL_BLOCK_DIM);
+
+    for (int i = 0; i < (int)walls.size(); ++i)
+         wall_grid.insert(i, walls[i].getLoc(), walls[i].getMaxLoc());
+
+    for (int i = 0; i < (int)wall_rects.size(); ++i)
+         wall_rect_grid.insert(i, wall_rects[i].getLoc(), wall_rects[i].getMaxLoc());
+
+    for (int i = 0; i < (int)doors.size(); ++i)
+         door_grid.insert(i, doors[i].getLoc(), doors[i].getMaxLoc());
 }
 
 // The next 2 functions combined allow for smooth speedup, slow down movement of object
@@ -776,7 +1112,8 @@ bool Game::checkDropEvent(mob *mb, item *it)
         mb->setItemCarryID(-1);
         mb->setItemCarryType(ITEMTYPE_NONE);
         it->setPossessionMobID(-1);
-        it->setLoc(addPoints(mb->getCenter(),multPoints(it->getDim(),point(-0.5,-0.5))));
+        it->setLoc(mb->getCenter() + it->getDim() * point(-0.5,-0.5));
+        markBroadphaseDirty();
         it->setVelocity(point(mb->getVelocity().x()*MOB_ITEM_DROP_VELOCITY_MODIFIER_X,-1.0*std::abs(mb->getVelocity().y()*MOB_ITEM_DROP_VELOCITY_MODIFIER_Y)));
         it->setAnimationStatus(false);
         it->togglePhysics(PHYSTYPE_FULL);
@@ -789,17 +1126,20 @@ bool Game::checkDropEvent(mob *mb, item *it)
 // item was picked up. These are non-equippable items.
 void Game::checkCollectPowerup() {
     if (!getPlayerMob()->isDead()) {
-        for (auto it = powerups.begin(); it != powerups.end(); ++it) {
-             if (collisionWithEntity(player_mob.getCenter(),player_mob.getDim(),&*it)) {
+        updateBroadphase();
+        powerup_hash.query(player_mob.getLoc() + point(-1.0,-1.0),player_mob.getMaxLoc() + point(1.0,1.0),powerup_candidates);
+        for (int k = 0; k < (int)powerup_candidates.size(); ++k) {
+             item *it = &powerups[powerup_candidates[k]];
+             if (collisionWithEntity(player_mob.getCenter(),player_mob.getDim(),it)) {
                  switch(it->getItemSuperFields()->i_category) {
                         case(ITEMCAT_HEALTH):
-                             collectHealthPowerup(&*it);
+                             collectHealthPowerup(it);
                              break;
                         case(ITEMCAT_VALUABLE):
-                             collectValuablePowerup(&*it);
+                             collectValuablePowerup(it);
                              break;
                         case(ITEMCAT_KEYCARD):
-                             collectInventoryItem(&*it);
+                             collectInventoryItem(it);
                              break;
                         default:
                              break;
@@ -815,7 +1155,7 @@ void Game::collectInventoryItem(item *itm)
 {
     player_inventory.push_back(item());
     int index = (int)player_inventory.size() - 1;
-    player_inventory[index].setItemFields(item_data[(int)itm->getItemType()],point(0.0,0.0),itm->entid());
+    player_inventory[index].setItemFields(itm->getItemType(),point(0.0,0.0),itm->entid());
     itm->setMarkForDeletion();
     sfx.playSoundEffect(sfx.getSoundEffect((int)SOUNDTYPE_COLLECT));
 }
@@ -826,7 +1166,7 @@ void Game::collectHealthPowerup(item *pwr)
     initial_health_fields health_stats = pwr->getItemSuperFields()->health_stats;
     if (health_stats.hp_increment > 0)
     {
-        if (getPlayerMob()->getHP() < getPlayerMob()->getMobSuperFields()->max_hp)
+        if (getPlayerMob()->getHP() < getPlayerMob()->getMaxHP())
         {
             pwr->setMarkForDeletion();
             getPlayerMob()->incHP(health_stats.hp_increment);
@@ -836,7 +1176,7 @@ void Game::collectHealthPowerup(item *pwr)
     else if (health_stats.maxhp_increment > 0)
     {
         pwr->setMarkForDeletion();
-        getPlayerMob()->setMaxHP(getPlayerMob()->getMobSuperFields()->max_hp + health_stats.maxhp_increment);
+        getPlayerMob()->setMaxHP(getPlayerMob()->getMaxHP() + health_stats.maxhp_increment);
         sfx.playSoundEffect(sfx.getSoundEffect((int)SOUNDTYPE_HEALTH));
     }
     else if (health_stats.explev_increment > 0)
@@ -878,6 +1218,7 @@ void Game::processLevelSpawnEvent()
 // Print pause string to middle of screen
 void Game::executeGamePauseActions()
 {
+    gfx.setSpriteLayer(SPRITELAYER_HUD);
     gfx.addBitmapString(color_white,"Game Paused - press p to resume",point(WINDOW_WIDTH/2.0 - 31.0*FONT_CHAR_WIDTH/2.0, WINDOW_HEIGHT/2.0 - FONT_CHAR_HEIGHT/2.0));
     gfx.updateScreen();
 }
@@ -898,8 +1239,11 @@ void Game::primaryGameLoop()
     {
         // used for stable framerate
         frame_start_timer = SDL_GetTicks();
+        profiler.beginFrame();
         // get input
+        profiler.beginPhase(PROFPHASE_PROCESSACTIONS);
         processActions();
+        profiler.endPhase(PROFPHASE_PROCESSACTIONS);
 
         if (quit_flag)
             return;
@@ -909,18 +1253,14 @@ void Game::primaryGameLoop()
         if (!game_paused)
         {
             // Do most of the game work
-            checkCollectPowerup();
-            applyAI();
-            applyPhysics();
-            updatePlayerTimers();
-            updateItemTimers();
-            updateDoorTimers();
-            updateAnimations();
-            processParticleEffects();
-            checkLevelUpEvent();
-            //processLevelSpawnEvent();
-            checkTargetIndicatorReset();
+            simulateFrame();
+            profiler.beginPhase(PROFPHASE_RENDERTEXTURES);
             renderTextures();
+            profiler.endPhase(PROFPHASE_RENDERTEXTURES);
+            profiler.setPhaseTime(PROFPHASE_RENDERWAIT,gfx.getRenderWaitTime());
+            profiler.setPhaseTime(PROFPHASE_RENDERTHREAD,gfx.getRenderThreadTime());
+            recordProfilerCounts();
+            profiler.endFrame();
         }
         else
             executeGamePauseActions();
@@ -930,13 +1270,185 @@ void Game::primaryGameLoop()
     }
 }
 
+// One tick of game logic (everything in the main loop except input and rendering)
+void Game::simulateFrame()
+{
+    checkCollectPowerup();
+    profiler.beginPhase(PROFPHASE_APPLYAI);
+    applyAI();
+    profiler.endPhase(PROFPHASE_APPLYAI);
+    profiler.beginPhase(PROFPHASE_APPLYPHYSICS);
+    applyPhysics();
+    profiler.endPhase(PROFPHASE_APPLYPHYSICS);
+    profiler.beginPhase(PROFPHASE_ENTITYDELETION);
+    deleteMarkedEntities();
+    profiler.endPhase(PROFPHASE_ENTITYDELETION);
+    updatePlayerTimers();
+    updateItemTimers();
+    updateDoorTimers();
+    profiler.beginPhase(PROFPHASE_UPDATEANIMATIONS);
+    updateAnimations();
+    profiler.endPhase(PROFPHASE_UPDATEANIMATIONS);
+    profiler.beginPhase(PROFPHASE_PARTICLEEFFECTS);
+    processParticleEffects();
+    profiler.endPhase(PROFPHASE_PARTICLEEFFECTS);
+    checkLevelUpEvent();
+    //processLevelSpawnEvent();
+    checkTargetIndicatorReset();
+}
+
+// Run the simulation for num_ticks ticks without a window, renderer or mixer.
+// Nothing is delayed, so this runs as fast as the CPU allows.
+void Game::runHeadless(int num_ticks)
+{
+    std::cout << "Seed: " << game_seed << "\n";
+    reseed();
+    initLevelObjects();
+    profiler.reset();
+
+    Uint64 start_counter = SDL_GetPerformanceCounter();
+
+    for (int i = 0; i < num_ticks; ++i)
+    {
+        profiler.beginFrame();
+        simulateFrame();
+        recordProfilerCounts();
+        profiler.endFrame();
+    }
+
+    double seconds = (double)(SDL_GetPerformanceCounter() - start_counter) / (double)SDL_GetPerformanceFrequency();
+
+    std::cout << "Headless: " << num_ticks << " ticks in " << seconds << " s";
+    if (seconds > 0.0)
+        std::cout << " (" << (double)num_ticks / seconds << " ticks/sec)";
+    std::cout << "\n";
+
+    cleanupLevelData();
+}
+
+// Start a fresh game directly on level "level" (used by the benchmark).
+// The player is given a huge amount of hitpoints so scenarios never end early.
+void Game::initBenchmarkLevel(int level)
+{
+    reseed();
+    cleanupLevelData();
+    std::vector<item>().swap(player_inventory);
+    profiler.reset();
+
+    current_level = level;
+    current_level_size.set(level_map_sizes[(int)std::min(9,current_level - 1)].x()*40.0,
+                           level_map_sizes[(int)std::min(9,current_level - 1)].y()*40.0);
+
+    // initLevelObjects only creates the player on level 1
+    player_mob.setMobFields(MOB_PLAYER,point(45.0,MAP_HEIGHT-82.0),0,1.0);
+    getPlayerMob()->setItemCarryID(-1);
+    getPlayerMob()->setItemCarryType(ITEMTYPE_NONE);
+
+    initLevelObjects();
+
+    getPlayerMob()->setMaxHP(1000000);
+    getPlayerMob()->setHP(1000000);
+}
+
+// Top up the npc vector to the maximum number of npcs allowed on the current level
+void Game::fillLevelWithNPCs()
+{
+    while ((int)npcs.size() < max_npc_vector_size[std::min(10,current_level)-1])
+        genOneNPC(getRandNPC(),false);
+}
+
+// Replace whatever the player is carrying with a new weapon of type "i_type"
+void Game::equipPlayerWeapon(item_type i_type)
+{
+    if (getPlayerMob()->getItemCarryType() != ITEMTYPE_NONE)
+        checkDropEvent(getPlayerMob(),getItemCarriedByMob(getPlayerMob()->entid()));
+
+    addItem(i_type,getPlayerMob()->getLoc(),false);
+    checkPickupEvent(getPlayerMob(),&items[(int)items.size()-1]);
+}
+
+// Run num_ticks ticks of the current level, keeping it filled with npcs.
+// If player_fires is set, the player fires the carried weapon every tick
+// (ignoring the weapon's usability timer) and turns around every 100 ticks.
+void Game::runBenchmarkTicks(int num_ticks, bool player_fires)
+{
+    for (int i = 0; i < num_ticks; ++i)
+    {
+        profiler.beginFrame();
+
+        if (i % 50 == 0)
+            fillLevelWithNPCs();
+
+        getPlayerMob()->setHP(getPlayerMob()->getMaxHP());
+
+        if (player_fires && getPlayerMob()->getItemCarryType() != ITEMTYPE_NONE)
+        {
+            if (i % 100 == 0)
+            {
+                getPlayerMob()->setXOrientation(getPlayerMob()->getXOrientation() == SDL_FLIP_NONE ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE);
+            }
+
+            item *weapon = getItemCarriedByMob(getPlayerMob()->entid());
+
+            switch(weapon->getItemType()) {
+                   case(ITEMTYPE_PISTOL):
+                   case(ITEMTYPE_REVOLVER):
+                   case(ITEMTYPE_SHOTGUN):
+                   case(ITEMTYPE_CHAINGUN):
+                        mobFireWeaponProjectile(getPlayerMob(),weapon);
+                        break;
+                   default:
+                        mobFireParticle(getPlayerMob(),weapon);
+                        break;
+            }
+        }
+
+        simulateFrame();
+        recordProfilerCounts();
+        profiler.endFrame();
+    }
+}
+
+// Generate the maps of levels 1 to num_levels (one profiler frame per level)
+void Game::runMapGenerationSweep(int num_levels)
+{
+    reseed();
+    profiler.reset();
+
+    for (int lev = 1; lev <= num_levels; ++lev)
+    {
+        cleanupLevelData();
+        current_level = lev;
+        current_level_size.set(level_map_sizes[(int)std::min(9,current_level - 1)].x()*40.0,
+                               level_map_sizes[(int)std::min(9,current_level - 1)].y()*40.0);
+
+        profiler.beginFrame();
+        beginLevelLoad();
+        generateMap();
+        endLevelLoad();
+        recordProfilerCounts();
+        profiler.endFrame();
+    }
+
+    cleanupLevelData();
+}
+
+frame_profiler *Game::getProfiler()
+{
+    return &profiler;
+}
+
 void Game::checkTargetIndicatorReset()
 {
     if (npcTargetFocusID >= 1)
-    if (sqrt(distanceSquared(getPlayerMob()->getCenter(),getMobFromEntityID(npcTargetFocusID)->getCenter())) > 450.0 &&
-        !isBoss(getMobFromEntityID(npcTargetFocusID)->getMobType()))
     {
-        npcTargetFocusID = -1;
+        mob *target = getMobFromEntityID(npcTargetFocusID);
+        // target npc was deleted, or is far away (and not a boss)
+        if (target == NULL ||
+           (sqrt(distanceSquared(getPlayerMob()->getCenter(),target->getCenter())) > 450.0 && !isBoss(target->getMobType())))
+        {
+            npcTargetFocusID = -1;
+        }
     }
 }
 
@@ -945,8 +1457,12 @@ void Game::processParticleEffects()
 {
     for (int i = 0; i < (int)particles.size(); ++i)
     {
-        for (int j = 0; j < (int)npcs.size(); ++j)
+        // only npcs near the particle can collide with it
+        updateBroadphase();
+        npc_hash.query(particles[i].getLoc() + point(-1.0,-1.0),particles[i].getMaxLoc() + point(1.0,1.0),npc_candidates);
+        for (int k = 0; k < (int)npc_candidates.size(); ++k)
         {
+            int j = npc_candidates[k];
             if (collisionWithEntity(particles[i].getCenter(), particles[i].getDim(), &(npcs[j])) &&
                 particles[i].getPhysicsStatus() == PHYSTYPE_FULL)
             {
@@ -982,13 +1498,13 @@ point getParticleStartVelocity(particle_type pl_type, bool flipped) {
     switch (pl_type) {
             case(PARTICLE_LASER):
             case(PARTICLE_ROCKET):
-                 vel = flipped ? multPoints(vel,point(-1.0,0.0)) : vel;
+                 vel = flipped ? (vel * point(-1.0,0.0)) : vel;
                  break;
             case(PARTICLE_FLAMESHOT):
-                 vel = flipped ? multPoints(vel,point(-1.0,1.0)) : vel;
+                 vel = flipped ? (vel * point(-1.0,1.0)) : vel;
                  break;
             case(PARTICLE_CANNONBALL):
-                 vel = flipped ? multPoints(vel, point(-0.65,-0.45)) : multPoints(vel, point(0.65,-0.45));
+                 vel = flipped ? (vel * point(-0.65,-0.45)) : (vel * point(0.65,-0.45));
                  break;
             default:
                  break;
@@ -1009,13 +1525,13 @@ point getParticleInsertLoc(item *weapon, particle_type pl_type, bool flipped)
                  loc = flipped ? min_loc : point(max_loc.x()-14.0, min_loc.y());
                  break;
             case(PARTICLE_ROCKET):
-                 loc = flipped ? addPoints(min_loc, point(0.0,4.0)) : point(max_loc.x()-14.0, min_loc.y()+4.0);
+                 loc = flipped ? (min_loc + point(0.0,4.0)) : point(max_loc.x()-14.0, min_loc.y()+4.0);
                  break;
             case(PARTICLE_CANNONBALL):
-                 loc = flipped ? addPoints(min_loc, point(20.0,6.0)) : point(max_loc.x()-30.0, min_loc.y()+6.0);
+                 loc = flipped ? (min_loc + point(20.0,6.0)) : point(max_loc.x()-30.0, min_loc.y()+6.0);
                  break;
             case(PARTICLE_FLAMESHOT):
-                 loc = flipped ? addPoints(min_loc, point(-40.0,-3.0)) : point(max_loc.x()-10.0, min_loc.y()-3.0);
+                 loc = flipped ? (min_loc + point(-40.0,-3.0)) : point(max_loc.x()-10.0, min_loc.y()-3.0);
                  break;
             default:
                  break;
@@ -1027,15 +1543,13 @@ point getParticleInsertLoc(item *weapon, particle_type pl_type, bool flipped)
 void Game::mobFireParticle(mob *mb, item *weapon) {
     particles.push_back(particle());
 
-    initial_item_super_fields * i_fields = weapon->getItemSuperFields();
-
     int index = (int)particles.size() - 1;
 
-    int hit_decrement = i_fields->wep_stats.hp_decrement;
+    int hit_decrement = weapon->getWeaponStats()->hp_decrement;
 
-    double knock_back = i_fields->wep_stats.knock_back;
+    double knock_back = weapon->getWeaponStats()->knock_back;
 
-    item_type it_type = i_fields->i_type;
+    item_type it_type = weapon->getItemType();
 
     particle_type pl_type = getplTypeFromittype(it_type);
 
@@ -1061,7 +1575,7 @@ void Game::mobTripleFlameAttack(mob *mb) {
     for (int i = 0; i < 3; ++i) {
         particles.push_back(particle());
         int index = (int)particles.size() - 1;
-        point loc = addPoints(mb->getCenter(),point(-50.0*n,8.0*i));
+        point loc = mb->getCenter() + point(-50.0*n,8.0*i);
         particles.back().setParticleFields(particle_data[(int)PARTICLE_FLAMESHOT],loc,index,mb->entid(),1,PARTICLE_FLAMESHOT,0.0,ITEMTYPE_NONE);
         setParticleFlags(PARTICLE_FLAMESHOT, (n == 1));
     }
@@ -1077,12 +1591,12 @@ void Game::setParticleFlags(particle_type pl_type, bool flipped) {
 }
 
 // First function called when a ballistic weapon is fired
-// Particles are not used for this, but rather a line drawer
-// that traces its path horizontally, checking for something to hit.
+// Particles are not used for this, but rather a horizontal ray
+// cast from the weapon (see fireBulletRay).
 void Game::mobFireWeaponProjectile(mob *mb, item *weapon) {
-    point projectile_drawer;
+    point projectile_origin;
 
-    int x_offset = ((mb->getXOrientation() == SDL_FLIP_NONE) ? 10 : -10);
+    double dir = ((mb->getXOrientation() == SDL_FLIP_NONE) ? 1.0 : -1.0);
     int y_offset = 0;
     int num_projectiles = 1;
 
@@ -1096,15 +1610,11 @@ void Game::mobFireWeaponProjectile(mob *mb, item *weapon) {
 
     for (int i = 0; i < num_projectiles; ++i) {
         if (mb->getXOrientation() == SDL_FLIP_NONE)
-            projectile_drawer.set(weapon->getMaxLoc().x(),weapon->getCenter().y()+y_offset);
+            projectile_origin.set(weapon->getMaxLoc().x(),weapon->getCenter().y()+y_offset);
         else
-            projectile_drawer.set(weapon->getLoc().x(),weapon->getCenter().y()+y_offset);
+            projectile_origin.set(weapon->getLoc().x(),weapon->getCenter().y()+y_offset);
 
-        while (!projectileDrawerHitWall(projectile_drawer)) {
-            if (projectileDrawerCollidingWithMob(mb,projectile_drawer))
-                break;
-            projectile_drawer.setx(projectile_drawer.x() + x_offset);
-        }
+        fireBulletRay(mb,projectile_origin,dir);
 
         y_offset += 2;
     }
@@ -1118,7 +1628,7 @@ void Game::mobFireWeaponProjectile(mob *mb, item *weapon) {
 // Apply knockback related to the death of a mob
 void Game::applyMobDeathKnockback(mob *mb, item_type weapon) {
     if (weapon != ITEMTYPE_FLAMETHROWER) {
-        mb->setMaxVelocity(multPoints(mb->getMaxVelocity(), point(25.0, 2.0)));
+        mb->setMaxVelocity(mb->getMaxVelocity() * point(25.0, 2.0));
         if (std::abs(mb->getVelocity().y()) < 0.1)
             mb->setVelocity(point(mb->getVelocity().x(), 0.0));
         mb->setVelocity(point(mb->getVelocity().x() * 3.0, -1.5 * std::abs(mb->getVelocity().y())));
@@ -1132,7 +1642,7 @@ void Game::setDeathType(mob* target, item_type weapon, int hp_decrement) {
         case(ITEMTYPE_REVOLVER):
         case(ITEMTYPE_CHAINGUN):
         case(ITEMTYPE_SHOTGUN):
-            if ((target->getMobType() == MOB_FIGHTER || target->getMobType() == MOB_SOLDIER || target->getMobType() == MOB_CAPTAIN || target->getMobType() == MOB_GUARD) && ((int)getItemCarriedByMob(0)->getWeaponModifierType() >= WEAPONMODIFIER_DAMAGING))
+            if ((target->getMobType() == MOB_FIGHTER || target->getMobType() == MOB_SOLDIER || target->getMobType() == MOB_CAPTAIN || target->getMobType() == MOB_GUARD) && getItemCarriedByMob(0) != NULL && ((int)getItemCarriedByMob(0)->getWeaponModifierType() >= WEAPONMODIFIER_DAMAGING))
                 target->setMobDeathType(MOBDEATHTYPE_BURST);
             else
                 target->setMobDeathType(MOBDEATHTYPE_KILLED);
@@ -1264,7 +1774,7 @@ void Game::damageMob(mob *target, int hp_dec, int causer_id, item_type weapon) {
 
 void Game::addPlayerExperience(mob *source, item_type wep_assoc)
 {
-    uint added_exp = (uint)source->getMobSuperFields()->base_exp_worth;
+    uint added_exp = (uint)source->getExpWorth();
     exp_points += added_exp;
     if ((int)wep_assoc >= (int)ITEMTYPE_PISTOL && (int)wep_assoc <= (int)ITEMTYPE_LASERGUN)
         weapon_exp[(int)wep_assoc - 1] += added_exp;
@@ -1317,7 +1827,7 @@ void Game::checkDamageMobFromParticle(particle *prtcl, mob *target)
 // A ballistic projectile hit a mob, so apply the relevant knockback to the target.
 void Game::applyMobProjectileKnockback(mob *target, mob *shooter)
 {
-    double knock_back = getItemCarriedByMob(shooter->entid())->getItemSuperFields()->wep_stats.knock_back;
+    double knock_back = getItemCarriedByMob(shooter->entid())->getWeaponStats()->knock_back;
 
     if (time_stopped)
         knock_back /= 10.0;
@@ -1355,7 +1865,8 @@ bool Game::checkDamageMobFromProjectile(mob *shooter, mob *target)
     if (!target->isDead())
     if ((shooter->entid() != target->entid()) && (shooter->entid() == 0 || target->entid() == 0))
     {
-        int hp_dec = getItemCarriedByMob(shooter->entid())->getItemSuperFields()->wep_stats.hp_decrement;
+        item *weapon = getItemCarriedByMob(shooter->entid());
+        int hp_dec = weapon->getWeaponStats()->hp_decrement;
 
         item_type wep_assoc = shooter->getItemCarryType();
 
@@ -1366,8 +1877,8 @@ bool Game::checkDamageMobFromProjectile(mob *shooter, mob *target)
 
         damageMob(target, hp_dec, shooter->entid(), wep_assoc);
 
-        squirtDynamicGibParticles(target,getItemCarriedByMob(shooter->entid())->getItemSuperFields()->wep_stats.large_hit_gibs, PROP_LARGEBLOOD);
-        squirtStaticGibParticles(target,getItemCarriedByMob(shooter->entid())->getItemSuperFields()->wep_stats.mini_hit_gibs, PROP_MINIBLOOD, 0, false);
+        squirtDynamicGibParticles(target,weapon->getWeaponStats()->large_hit_gibs, PROP_LARGEBLOOD);
+        squirtStaticGibParticles(target,weapon->getWeaponStats()->mini_hit_gibs, PROP_MINIBLOOD, 0, false);
 
         return true;
     }
@@ -1380,78 +1891,132 @@ void Game::addBonusDamage(int &hp_dec, item_type wep_assoc)
     hp_dec += (weapon_exp_bonus[(int)wep_assoc-1] * weapon_bonus_level_damage_multipliers[(int)wep_assoc - 1]);
 }
 
-// Did a ballistic weapon bullet hit a mob?
-bool Game::projectileDrawerCollidingWithMob(mob *shooter, point projectile_drawer)
+// Cast a bullet ray from "origin" in direction "dir" (1.0 right, -1.0 left).
+// The bullet hits the nearest mob in front of the first wall or door that
+// accepts the hit (checkDamageMobFromProjectile), e.g. npc bullets pass through other npcs.
+// Ties go to the wall, then to npcs in index order, then to the player.
+void Game::fireBulletRay(mob *shooter, point origin, double dir)
 {
-    for (int i = 0; i < (int)npcs.size(); ++i)
+    double wall_dist = getBulletWallDistance(origin,dir);
+    double dist;
+
+    if (wall_dist <= 0.0)
+        return;
+
+    bullet_hits.clear();
+
+    // npcs between the origin and the wall
+    updateBroadphase();
+    npc_hash.query(point(std::min(origin.x(),origin.x() + dir*wall_dist) - 1.0,origin.y() - 1.0),
+                   point(std::max(origin.x(),origin.x() + dir*wall_dist) + 1.0,origin.y() + 1.0),npc_candidates);
+
+    for (int k = 0; k < (int)npc_candidates.size(); ++k)
     {
-        if (collisionWithEntity(projectile_drawer, point(1,1), &npcs[i]))
-        {
-            if (checkDamageMobFromProjectile(shooter,&npcs[i]))
-               return true;
-        }
+        dist = getRayEntryDistance(origin,dir,&npcs[npc_candidates[k]]);
+        if (dist >= 0.0 && dist < wall_dist)
+            bullet_hits.push_back({dist,npc_candidates[k],&npcs[npc_candidates[k]]});
     }
-    if (collisionWithEntity(projectile_drawer, point(1,1), getPlayerMob()))
+
+    dist = getRayEntryDistance(origin,dir,getPlayerMob());
+    if (dist >= 0.0 && dist < wall_dist)
+        bullet_hits.push_back({dist,(int)npcs.size(),getPlayerMob()});
+
+    std::sort(bullet_hits.begin(),bullet_hits.end(),compareBulletHits);
+
+    // checkDamageMobFromProjectile has no side effects when it returns false,
+    // so the hit list stays valid until the first real hit
+    for (int i = 0; i < (int)bullet_hits.size(); ++i)
     {
-        if (checkDamageMobFromProjectile(shooter,getPlayerMob()))
-            return true;
+        if (checkDamageMobFromProjectile(shooter,bullet_hits[i].target))
+            return;
     }
-    return false;
+}
+
+// Distance a bullet travels from "origin" in direction "dir" before it hits a wall or door,
+// or leaves the map. The tile grid is walked one column at a time starting at the origin,
+// stopping as soon as the next column is farther away than the nearest hit found so far.
+double Game::getBulletWallDistance(point origin, double dir)
+{
+    if (!inRange(origin,point(0.0,0.0),point(MAP_WIDTH,MAP_HEIGHT)))
+        return 0.0;
+
+    double nearest = ((dir > 0.0) ? MAP_WIDTH - origin.x() : origin.x());
+    double col_x = std::floor(origin.x() / SMALL_BLOCK_DIM) * SMALL_BLOCK_DIM;
+    double col_dist = 0.0;
+    double dist;
+
+    while (col_dist <= nearest)
+    {
+        // a query at the middle of the column only touches that column
+        point col_min = point(col_x + SMALL_BLOCK_DIM / 2.0,origin.y() - 0.5);
+        point col_max = point(col_x + SMALL_BLOCK_DIM / 2.0,origin.y() + 0.5);
+
+        // (the nearest entry into a rectangle equals the nearest entry into its tiles)
+        wall_rect_grid.query(col_min,col_max,blocker_candidates);
+        for (int i = 0; i < (int)blocker_candidates.size(); ++i)
+        {
+            dist = getRayEntryDistance(origin,dir,&wall_rects[blocker_candidates[i]]);
+            if (dist >= 0.0 && dist < nearest)
+                nearest = dist;
+        }
+
+        door_grid.query(col_min,col_max,blocker_candidates);
+        for (int i = 0; i < (int)blocker_candidates.size(); ++i)
+        {
+            dist = getRayEntryDistance(origin,dir,&doors[blocker_candidates[i]]);
+            if (dist >= 0.0 && dist < nearest)
+                nearest = dist;
+        }
+
+        // next column (blockers are dilated by half a pixel, like a 1x1 bullet)
+        col_x += dir * SMALL_BLOCK_DIM;
+        col_dist = ((dir > 0.0) ? col_x - 0.5 - origin.x() : origin.x() - (col_x + SMALL_BLOCK_DIM + 0.5));
+    }
+
+    return nearest;
 }
 
 // Add large blood particle props when enemy damaged by weapon that allows for these props to be created
 void Game::squirtDynamicGibParticles(mob *mb, int num_particles, prop_type ptype)
 {
-    int index = 0;
+    int slot = 0;
     point loc;
     for (int i = 0; i < num_particles; ++i)
     {
-        props.push_back(dynamic_entity());
-        index = (int)props.size() - 1;
         loc = point((double)randZero((int)(mb->getDim().x() - 22.0)) + mb->getLoc().x(),(double)randZero((int)(mb->getDim().y() - 20.0)) + mb->getLoc().y());
-        props[index].setDynamicEntityFields(prop_data[(int)ptype],loc,index);
-        props[index].setAnimationSpeed(props[index].getAnimationSpeed() + randZero(5));
-        props[index].setXOrientation(roll(2) ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL);
-        props[index].setXDeltaNormal(mb->getXDeltaNormal());
-        props[index].setResetFrameFlag(false);
-        props[index].setAnimationStatus(true);
-        props[index].setVelocity(mb->getVelocity());
+        slot = props.spawnProp(prop_data[(int)ptype],loc);
+        props.setAnimationSpeed(slot,props.getAnimationSpeed(slot) + randZero(5));
+        props.setXOrientation(slot,roll(2) ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL);
+        props.setXDeltaNormal(slot,mb->getXDeltaNormal());
+        props.setResetFrameFlag(slot,false);
+        props.setAnimationStatus(slot,true);
+        props.setVelocity(slot,mb->getVelocity());
         if (!mb->isDead())
-            props[index].setXDeltaNormal(0.0);
+            props.setXDeltaNormal(slot,0.0);
     }
 }
 
 // Add miniature blood particle props when enemy damaged by weapon that allows for these props to be created
 void Game::squirtStaticGibParticles(mob *mb, int num_particles, prop_type ptype, int texture_row, bool exploded)
 {
-    int index = 0;
+    int slot = 0;
     double delta_normal = 0.0;
     for (int i = 0; i < num_particles; ++i) {
-        props.push_back(dynamic_entity());
-        index = (int)props.size() - 1;
         delta_normal = -1.0 + (double)(2 * randZero(1));
-        props.back().setDynamicEntityFields(prop_data[(int)ptype],point(mb->getCenter().x()-2.0,mb->getCenter().y()-2.0),index);
-        props.back().setXOrientation(roll(2) ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL);
-        props.back().setXDeltaNormal(delta_normal);
-        props.back().setDestructableUponCollision(true);
-        props.back().setVelocity(point(delta_normal*(double)randInt(1,20)/2.0,-3.6-(double)randZero(19)/5.0));
+        slot = props.spawnProp(prop_data[(int)ptype],point(mb->getCenter().x()-2.0,mb->getCenter().y()-2.0));
+        props.setXOrientation(slot,roll(2) ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL);
+        props.setXDeltaNormal(slot,delta_normal);
+        props.setDestructableUponCollision(slot,true);
+        props.setVelocity(slot,point(delta_normal*(double)randInt(1,20)/2.0,-3.6-(double)randZero(19)/5.0));
         if (exploded) {
-            props.back().setVelocity(multPoints(props.back().getVelocity(), point(1.2, 1.0)));
+            props.setVelocity(slot,props.getVelocity(slot) * point(1.2, 1.0));
         }
 
-        props.back().setXDeltaNormal(0.0);
-        props.back().setTextureRow(texture_row);
+        props.setXDeltaNormal(slot,0.0);
+        props.setTextureRow(slot,texture_row);
     }
 }
 
-// Did a ballistic weapon bullet hit a wall or door?
-bool Game::projectileDrawerHitWall(point projectile_drawer) {
-    if (!inRange(projectile_drawer,point(0.0,0.0),point(MAP_WIDTH,MAP_HEIGHT)))
-        return true;
-
-    return isCollidingWithStaticBlocker(projectile_drawer, point(1,1));
-}
-
 // NPC movement AI
 void Game::npcMoveEvent(mob *mb)
 {
@@ -1525,8 +2090,11 @@ void Game::npcWeaponEvent(mob *mb)
     {
         if (mb->getItemCarryType() == ITEMTYPE_NONE)
         {
-            for (int j = 0; j < (int)items.size(); ++j)
+            updateBroadphase();
+            item_hash.query(mb->getLoc() + point(-1.0,-1.0),mb->getMaxLoc() + point(1.0,1.0),item_candidates);
+            for (int k = 0; k < (int)item_candidates.size(); ++k)
             {
+                int j = item_candidates[k];
                 if (collisionWithEntity(mb->getCenter(),mb->getDim(),&items[j]))
                 {
                     if (checkPickupEvent(mb,&items[j]))
@@ -1548,6 +2116,36 @@ void Game::npcWeaponEvent(mob *mb)
     }
 }
 
+// Distance along a horizontal ray from "origin" (direction "dir") to where it enters "ent",
+// or -1.0 if it misses. The entity is dilated by half a pixel on each side (a 1x1 bullet).
+double getRayEntryDistance(point origin, double dir, entity *ent)
+{
+    point min_loc = point(ent->getLoc().x() - 0.5,ent->getLoc().y() - 0.5);
+    point max_loc = point(ent->getMaxLoc().x() + 0.5,ent->getMaxLoc().y() + 0.5);
+
+    if (origin.y() < min_loc.y() || origin.y() > max_loc.y())
+        return -1.0;
+
+    if (dir > 0.0)
+    {
+        if (max_loc.x() < origin.x())
+            return -1.0;
+        return std::max(0.0,min_loc.x() - origin.x());
+    }
+
+    if (min_loc.x() > origin.x())
+        return -1.0;
+    return std::max(0.0,origin.x() - max_loc.x());
+}
+
+// nearest first, then npcs by index, then the player
+bool compareBulletHits(bullet_hit a, bullet_hit b)
+{
+    if (a.dist != b.dist)
+        return a.dist < b.dist;
+    return a.order < b.order;
+}
+
 // Should NPC detect the player?
 bool npcDetectCondition(mob *mb, mob *pmb) {
     if (sqrt(distanceSquared(pmb->getCenter(),mb->getCenter())) < mb->getMobSuperFields()->field_of_view)
@@ -1601,7 +2199,7 @@ void Game::npcMeleeEvent(mob *mb) {
     if (rollPerc(mb->getMobSuperFields()->melee_frequency))
     if (!getPlayerMob()->isDead())
     if (collisionWithEntity(mb->getCenter(),mb->getDim(),getPlayerMob())) {
-        damageMob(getPlayerMob(),mb->getMobSuperFields()->melee_damage,mb->entid(), ITEMTYPE_NONE);
+        damageMob(getPlayerMob(),mb->getMeleeDamage(),mb->entid(), ITEMTYPE_NONE);
         // NPC disarms player if it has the special ability to do so.
         if (mb->getMobSuperFields()->p_type == POWERTYPE_DISARM)
         {
@@ -1611,7 +2209,7 @@ void Game::npcMeleeEvent(mob *mb) {
         if (mb->getMobSuperFields()->p_type == POWERTYPE_SLOW)
         {
             playerSlowTimer = 100;
-            getPlayerMob()->setMaxVelocity(multPoints(mob_data[(int)MOB_PLAYER].idef.max_velocity, point(0.5, 1.0)));
+            getPlayerMob()->setMaxVelocity(mob_data[(int)MOB_PLAYER].idef.max_velocity * point(0.5, 1.0));
         }
     }
 }
@@ -1650,6 +2248,7 @@ void Game::mobToggleLadderEvent(mob *mb) {
      for (auto it = ladders.begin(); it != ladders.end(); ++it) {
           if (collisionWithEntity(mb->getCenter(),mb->getDim(),&*it)) {
               mb->setLoc(point(it->getCenter().x() - (mb->getDim().x()/2.0),mb->getLoc().y()));
+              markBroadphaseDirty();
               mb->setLadderStatus(true);
               mb->setXDeltaNormal(0.0);
               mb->setVelocity(point(0.0,0.0));
@@ -1663,7 +2262,10 @@ void Game::mobToggleLadderEvent(mob *mb) {
 void Game::mobClimbLadderEvent(mob *mb, bool move_down)
 {
     if (mb->getLadderStatus())
+    {
         mb->incLoc(point(0.0,((move_down == true) ? 1.0 : -1.0)*3.0));
+        markBroadphaseDirty();
+    }
     bool got_off_ladder = true;
     for (int i = 0; i < (int)ladders.size(); ++i)
     {
@@ -1674,14 +2276,8 @@ void Game::mobClimbLadderEvent(mob *mb, bool move_down)
         }
     }
     if (move_down || mb->getMobType() != MOB_PLAYER)
-    for (int i = 0; i < (int)walls.size(); ++i)
-    {
-        if (collisionWithEntity(addPoints(mb->getCenter(),point(0.0,1.0)),mb->getDim(),&walls[i]))
-        {
-            got_off_ladder = true;
-            break;
-        }
-    }
+    if (isCollidingWithWallRect(mb->getCenter() + point(0.0,1.0),mb->getDim()))
+        got_off_ladder = true;
     if (got_off_ladder)
         getOffLadder(mb,false);
 }
@@ -1738,10 +2334,11 @@ void Game::applyPhysics()
     }
 
     // prop physics
-    for (int i = 0; i < (int)props.size(); ++i)
+    props.integrateProps();
+    for (int i = 0; i < props.size(); ++i)
     {
-        if (!(props[i].getVelocity().y() == 0.0 && !props[i].getVerticalMotionFlag()))
-            applyPhysicsForDynamicEntity(&props[i]);
+        if (props.hasMoved(props.getSlot(i)))
+            applyPropCollisions(props.getSlot(i));
     }
 
     // npc physics
@@ -1774,48 +2371,66 @@ void Game::applyPhysics()
             applyPhysicsForItem(&powerups[i]);
     }
 
+    markBroadphaseDirty();
+}
+
+// remove particles, npcs, props and powerups that are done (runs right after applyPhysics)
+void Game::deleteMarkedEntities()
+{
+    markBroadphaseDirty();
+
+    // Each container is compacted in a single pass (survivors keep their order), so
+    // the cost doesn't depend on how many entities die in one frame.
+    int old_size = (int)particles.size();
+    int num_kept = 0;
+
+    explosion_sources.clear();
+
     // check particle deletion
     for (int i = 0; i < (int)particles.size(); ++i)
     {
         if (destroyParticleCondition(&particles[i]))
         {
             if (particles[i].getParticleType() == PARTICLE_CANNONBALL || particles[i].getParticleType() == PARTICLE_ROCKET)
-                createExplosion(particles[i].getLoc(),particles[i].getCreatorID(),particles[i].getDamageValue(),particles[i].getKnockBack(),
-                               (particles[i].getParticleType() == PARTICLE_CANNONBALL) ? ITEMTYPE_CANNON : ITEMTYPE_ROCKETLAUNCHER);
-            particles.erase(particles.begin() + i);
-            i--;
+                explosion_sources.push_back(particles[i]);
         }
-    }
-
-    // check npc deletion
-    for (int i = 0; i < (int)npcs.size(); ++i)
-    {
-        if (npcs[i].getMarkForDeletion())
+        else
         {
-            npcs.erase(npcs.begin() + i);
-            i--;
+            if (num_kept != i)
+                particles[num_kept] = particles[i];
+            num_kept++;
         }
     }
 
+    particles.resize(num_kept);
+    num_deleted_entities = old_size - num_kept;
+
+    // explosions go after the surviving particles, in the order their sources died
+    for (int i = 0; i < (int)explosion_sources.size(); ++i)
+        createExplosion(explosion_sources[i].getLoc(),explosion_sources[i].getCreatorID(),explosion_sources[i].getDamageValue(),explosion_sources[i].getKnockBack(),
+                       (explosion_sources[i].getParticleType() == PARTICLE_CANNONBALL) ? ITEMTYPE_CANNON : ITEMTYPE_ROCKETLAUNCHER);
+
+    // check npc deletion
+    old_size = (int)npcs.size();
+    npcs.erase(std::remove_if(npcs.begin(),npcs.end(),isMarkedForDeletion),npcs.end());
+
+    if ((int)npcs.size() != old_size)
+        rebuildNPCIndexTable();
+
+    num_deleted_entities += old_size - (int)npcs.size();
+
     // check prop deletion
-    for (int i = 0; i < (int)props.size(); ++i)
-    {
-        if (props[i].getMarkForDeletion())
-        {
-            props.erase(props.begin() + i);
-            i--;
-        }
-    }
+    num_deleted_entities += props.removeMarkedProps();
 
     // check powerup deletion (was picked up by player)
-    for (int i = 0; i < (int)powerups.size(); ++i)
-    {
-        if (powerups[i].getMarkForDeletion())
-        {
-            powerups.erase(powerups.begin() + i);
-            i--;
-        }
-    }
+    old_size = (int)powerups.size();
+    powerups.erase(std::remove_if(powerups.begin(),powerups.end(),isMarkedForDeletion),powerups.end());
+    num_deleted_entities += old_size - (int)powerups.size();
+}
+
+bool isMarkedForDeletion(dynamic_entity &ent)
+{
+    return ent.getMarkForDeletion();
 }
 
 // create an explosion (as a result of cannon or rocket)
@@ -1864,8 +2479,9 @@ void Game::applyPhysicsForItem(item *it)
         applyPhysicsForDynamicEntity(it);
     else
     {
-        SDL_RendererFlip mob_x_orientation = getMobCarryingItem(it->entid())->getXOrientation();
-        point mob_center = getMobCarryingItem(it->entid())->getCenter();
+        mob *carrier = getMobCarryingItem(it->entid());
+        SDL_RendererFlip mob_x_orientation = carrier->getXOrientation();
+        point mob_center = carrier->getCenter();
         item_type i_type = it->getItemType();
         it->setXOrientation(mob_x_orientation);
 
@@ -1873,7 +2489,7 @@ void Game::applyPhysicsForItem(item *it)
         if (i_type == ITEMTYPE_LASERGUN)
         {
             offset_x = 8.0;
-            if (getMobCarryingItem(it->entid())->getMobType() == MOB_ADVANCEDAGENT)
+            if (carrier->getMobType() == MOB_ADVANCEDAGENT)
             {
                 offset_x = 12.0;
                 offset_y = -9.0;
@@ -1899,6 +2515,7 @@ bool Game::mobFacingTarget(mob *facer, mob *target)
 void Game::processActions()
 {
     evt_handler.processKey();
+    checkRendererReset();
 
     if (evt_handler.quitKeyPressed() && !game_paused && !getPlayerMob()->isDead())
     {
@@ -1918,6 +2535,15 @@ void Game::processActions()
         return;
     }
 
+    if (evt_handler.profilerKeyPressed())
+        profiler.toggleOverlay();
+
+    if (evt_handler.profilerDumpKeyPressed())
+    {
+        if (dumpProfile("profile.csv"))
+            std::cout << "Profile written to profile.csv\n";
+    }
+
     if (evt_handler.pauseKeyPressed() && !getPlayerMob()->isDead())
     {
         game_paused = !game_paused;
@@ -2043,6 +2669,9 @@ void Game::restartGameEvent()
     current_level_size.set(level_map_sizes[0].x()*40.0,
                            level_map_sizes[0].y()*40.0);
 
+    // same seed, same game
+    reseed();
+
     // build level 1
     // player's health is reset here
     initLevelObjects();
@@ -2054,7 +2683,7 @@ void Game::endLevelEvent()
     // Player's corpse cannot walk through exit door
     if (!getPlayerMob()->isDead())
     // Player is at exit door
-    if (inRange(getPlayerMob()->getLoc(),exit_loc,addPoints(exit_loc,point(20.0,20.0))))
+    if (inRange(getPlayerMob()->getLoc(),exit_loc,exit_loc + point(20.0,20.0)))
     {
         // Only entity preserved going to next level is the weapon the player is carrying
         // and its modifier flags (not used if ic_type == ITEMTYPE_NONE)
@@ -2105,20 +2734,25 @@ void Game::mobDoorEvent(mob *mb)
         lfid = switches[i].getLevelFeatureID();
         if (collisionWithEntity(mb->getCenter(),mb->getDim(),&switches[i]))
         {
+            door *dr = getDoorConnectedToSwitch(lfid);
+
+            if (dr == NULL)
+                continue;
+
             // not locked
-            if (!getDoorConnectedToSwitch(lfid)->isLocked())
+            if (!dr->isLocked())
             {
-                if (getDoorConnectedToSwitch(lfid)->getDoorState() == DOORSTATE_OPENED)
+                if (dr->getDoorState() == DOORSTATE_OPENED)
                 {
-                    getDoorConnectedToSwitch(lfid)->setDoorState(DOORSTATE_CLOSING);
+                    dr->setDoorState(DOORSTATE_CLOSING);
                 }
-                if (getDoorConnectedToSwitch(lfid)->getDoorState() == DOORSTATE_CLOSED)
+                if (dr->getDoorState() == DOORSTATE_CLOSED)
                 {
-                    if (getDoorConnectedToSwitch(lfid)->getSizeType() == DOORSZE_SMALL)
+                    if (dr->getSizeType() == DOORSZE_SMALL)
                         sfx.playSoundEffect(sfx.getSoundEffect((int)SOUNDTYPE_OPENDOOR1));
                     else
                         sfx.playSoundEffect(sfx.getSoundEffect((int)SOUNDTYPE_OPENDOOR2));
-                    getDoorConnectedToSwitch(lfid)->setDoorState(DOORSTATE_OPENING);
+                    dr->setDoorState(DOORSTATE_OPENING);
                 }
                 break;
             }
@@ -2133,7 +2767,7 @@ void Game::mobDoorEvent(mob *mb)
                         {
                             sfx.playSoundEffect(sfx.getSoundEffect((int)SOUNDTYPE_UNLOCKDOOR));
                             player_inventory.erase(player_inventory.begin() + j);
-                            getDoorConnectedToSwitch(lfid)->setLockStatus(false);
+                            dr->setLockStatus(false);
                             break;
                         }
                     }
@@ -2271,7 +2905,7 @@ void applyMobFireKickBack(mob *mb, item_type it_type) {
     }
 
     if (mb->getXOrientation() == SDL_FLIP_NONE)
-        mb->incVelocity(multPoints(kb,point(-1.0,1.0)));
+        mb->incVelocity(kb * point(-1.0,1.0));
     else
         mb->incVelocity(kb);
 }
@@ -2322,46 +2956,79 @@ void Game::mobFireWeapon(mob *mb) {
     }
 }
 
-// Only can be called if mob with id "entid" is carrying a weapon.
-// Return the item carried by the mob with entity id "entid".
+// Return the item carried by the mob with entity id "entid" (NULL if it carries nothing).
+// A mob's item carry id is the entity id of its item, which is also the item's index.
 item * Game::getItemCarriedByMob(int entid)
 {
-    std::vector <item> :: iterator itr = std::find_if(items.begin(), items.end(), [entid](item &itm)
-    {
-        return entid == itm.getPossessionMobID();
-    });
-    return &*itr;
+    mob *mb = getMobFromEntityID(entid);
+
+    if (mb == NULL)
+        return NULL;
+
+    item *it = getItemFromEntityID(mb->getItemCarryID());
+
+    if (it == NULL || it->getPossessionMobID() != entid)
+        return NULL;
+
+    return it;
+}
+
+// Items are never erased during a level, so an item's entity id is its index
+item * Game::getItemFromEntityID(int entid)
+{
+    if (entid < 0 || entid >= (int)items.size() || items[entid].entid() != entid)
+        return NULL;
+
+    return &items[entid];
 }
 
 // Each switch has an associated door based on a "feature id". Given this switch's feature
-// id, find the corresponding door in the door vector
+// id, find the corresponding door in the door vector (the feature id is the door's index)
 door * Game::getDoorConnectedToSwitch(int entid)
 {
-    std::vector <door> :: iterator itr = std::find_if(doors.begin(), doors.end(), [entid](door &dr)
-    {
-        return entid == dr.entid();
-    });
-    return &*itr;
+    if (entid < 0 || entid >= (int)doors.size() || doors[entid].entid() != entid)
+        return NULL;
+
+    return &doors[entid];
 }
 
+// Get the player (entid 0) or the npc with entity id "entid" (NULL if it no longer exists)
 mob* Game::getMobFromEntityID(int entid)
 {
-    std::vector <mob> ::iterator itr = std::find_if(npcs.begin(), npcs.end(), [entid](mob& mb)
-    {
-        return entid == mb.entid();
-    });
-    return &*itr;
+    if (entid == 0)
+        return getPlayerMob();
+
+    if (entid < 0 || entid >= (int)npc_index_from_id.size() || npc_index_from_id[entid] == -1)
+        return NULL;
+
+    return &npcs[npc_index_from_id[entid]];
 }
 
 // Given the id of an item, get the mob (player or npc) carrying it.
 mob * Game::getMobCarryingItem(int entid)
 {
+    item *it = getItemFromEntityID(entid);
+
+    if (it == NULL || it->getPossessionMobID() == -1)
+        return getPlayerMob();
+
+    mob *mb = getMobFromEntityID(it->getPossessionMobID());
+
+    return (mb == NULL ? getPlayerMob() : mb);
+}
+
+// npc_index_from_id[id] is the index in npcs of the npc with entity id "id" (-1 if gone).
+// Must be called whenever npcs are erased.
+void Game::rebuildNPCIndexTable()
+{
+    std::fill(npc_index_from_id.begin(),npc_index_from_id.end(),-1);
+
     for (int i = 0; i < (int)npcs.size(); ++i)
     {
-        if (npcs[i].getItemCarryID() == entid)
-            return &npcs[i];
+        if ((int)npc_index_from_id.size() <= npcs[i].entid())
+            npc_index_from_id.resize(npcs[i].entid() + 1,-1);
+        npc_index_from_id[npcs[i].entid()] = i;
     }
-    return getPlayerMob();
 }
 
 // Keep game running at consistent 50 fps.
@@ -2391,74 +3058,94 @@ SDL_Color Game::getWallColor(int i)
 
 // This function needs to be refactored.
 // Update camera, and render everything on the screen.
+// Everything is batched by gfx and drawn (layer by layer) in updateScreen.
 void Game::renderTextures()
 {
     gfx.updateCamera(getPlayerMob()->getCenter(),current_level_size);
+    if (static_layers_dirty)
+        bakeStaticLayers();
     gfx.clearScreen();
-    for (int i = 0; i < numBackdrops(); ++i)
-    {
-        gfx.renderSprite(gfx.getTexture(backdrops[i].getTextureIndex()),backdrops[i].getLoc(),backdrops[i].getTextureDim(),backdrops[i].getDim(),0,0,SDL_FLIP_NONE,(i == 0),global_tint[(int)TIMESTOPCT_BACKDROP],2);
-    }
-    for (int i = 0; i < (int)static_props.size(); ++i)
+    // the first backdrop is fixed to the screen
+    if (numBackdrops() > 0)
+        gfx.renderSprite(gfx.getTexture(backdrops[0].getTextureIndex()),backdrops[0].getLoc(),backdrops[0].getTextureDim(),backdrops[0].getDim(),0,0,SDL_FLIP_NONE,true,global_tint[(int)TIMESTOPCT_BACKDROP],2);
+    if (static_layers_baked)
     {
-        gfx.renderSprite(gfx.getTexture(static_props[i].getTextureIndex()),static_props[i].getLoc(),static_props[i].getTextureDim(),static_props[i].getDim(),0,0,SDL_FLIP_NONE,false,global_tint[(int)TIMESTOPCT_STATICPROPS],2);
-    }
-    for (int i = 0; i < (int)switches.size(); ++i)
-    {
-        gfx.renderSprite(gfx.getTexture(switches[i].getTextureIndex()),switches[i].getLoc(),switches[i].getTextureDim(),switches[i].getDim(),0,0,SDL_FLIP_NONE,false,global_tint[(int)TIMESTOPCT_SWITCHES],2);
+        gfx.setSpriteLayer(SPRITELAYER_STATIC_BELOW_DOORS);
+        gfx.renderStaticLayer(STATICLAYER_BELOW_DOORS);
     }
+    else
+        renderStaticSprites(STATICLAYER_BELOW_DOORS,point(0.0,0.0),current_level_size);
+    gfx.setSpriteLayer(SPRITELAYER_DOORS);
     for (int i = 0; i < (int)doors.size(); ++i)
     {
         gfx.renderSprite(gfx.getTexture(doors[i].getTextureIndex()),doors[i].getLoc(),doors[i].getTextureDim(),doors[i].getDim(),0,0,SDL_FLIP_NONE,false,global_tint[(int)TIMESTOPCT_DOORS],2);
     }
-    for (int i = 0; i < (int)numWallBlocks(); ++i)
+    if (static_layers_baked)
     {
-        gfx.renderSprite(gfx.getTexture(walls[i].getTextureIndex()),walls[i].getLoc(),walls[i].getTextureDim(),walls[i].getDim(),0,0,SDL_FLIP_NONE,false,getWallColor(i),2);
-    }
-    for (int i = 0; i < (int)ladders.size(); ++i) {
-        gfx.renderSprite(gfx.getTexture(ladders[i].getTextureIndex()),ladders[i].getLoc(),ladders[i].getTextureDim(),ladders[i].getDim(),0,0,SDL_FLIP_NONE,false, ladders[i].getLadderTint(), 2);
+        gfx.setSpriteLayer(SPRITELAYER_STATIC_ABOVE_DOORS);
+        gfx.renderStaticLayer(STATICLAYER_ABOVE_DOORS);
     }
-    for (int i = 0; i < (int)npcs.size(); ++i)
-    {
+    else
+        renderStaticSprites(STATICLAYER_ABOVE_DOORS,point(0.0,0.0),current_level_size);
+    // Only npcs, items and powerups near the camera are considered (the margin covers
+    // weapons and health bars drawn next to their npc). Everything else that is off
+    // screen is skipped by renderSprite.
+    point view_min = gfx.getCamera() * 0.5 - point(RENDER_CULL_MARGIN,RENDER_CULL_MARGIN);
+    point view_max = gfx.getCamera() * 0.5 + point(WINDOW_WIDTH / 2.0 + RENDER_CULL_MARGIN,WINDOW_HEIGHT / 2.0 + RENDER_CULL_MARGIN);
+    updateBroadphase();
+    npc_hash.query(view_min,view_max,npc_candidates);
+    item_hash.query(view_min,view_max,item_candidates);
+    powerup_hash.query(view_min,view_max,powerup_candidates);
+    gfx.countCulledSprites((int)(npcs.size() - npc_candidates.size()) +
+                           (int)(items.size() - item_candidates.size()) +
+                           (int)(powerups.size() - powerup_candidates.size()));
+    gfx.setSpriteLayer(SPRITELAYER_NPCS);
+    for (int k = 0; k < (int)npc_candidates.size(); ++k)
+    {
+        int i = npc_candidates[k];
         if (npcs[i].getMobSuperFields()->p_type != POWERTYPE_THROUGHWALLS)
         {
             gfx.renderSprite(gfx.getTexture(npcs[i].getTextureIndex()),npcs[i].getLoc(),npcs[i].getTextureDim(),npcs[i].getDim(),npcs[i].getCurrentFrame(),getMobModRow(&npcs[i]),npcs[i].getXOrientation(),false,getMobTint(&npcs[i]),2);
             // Make sure the NPC's weapon texture is placed directly *in front* of the NPC texture.
-            if (npcs[i].getItemCarryType() != ITEMTYPE_NONE)
-                gfx.renderSprite(gfx.getTexture(getItemCarriedByMob(npcs[i].entid())->getTextureIndex()),
-                                                getItemCarriedByMob(npcs[i].entid())->getLoc(),
-                                                getItemCarriedByMob(npcs[i].entid())->getTextureDim(),getItemCarriedByMob(npcs[i].entid())->getDim(),
-                                                getItemCarriedByMob(npcs[i].entid())->getCurrentFrame(),getWeaponModRow(getItemCarriedByMob(npcs[i].entid())),
-                                                getItemCarriedByMob(npcs[i].entid())->getXOrientation(),false,getMobTint(&npcs[i]), 2);
+            item *weapon = getItemCarriedByMob(npcs[i].entid());
+            if (weapon != NULL)
+                gfx.renderSprite(gfx.getTexture(weapon->getTextureIndex()),weapon->getLoc(),weapon->getTextureDim(),weapon->getDim(),
+                                 weapon->getCurrentFrame(),getWeaponModRow(weapon),weapon->getXOrientation(),false,getMobTint(&npcs[i]), 2);
             printNPCHealthBar(&npcs[i]);
         }
     }
-    for (int i = 0; i < (int)props.size(); ++i)
+    gfx.setSpriteLayer(SPRITELAYER_PROPS);
+    for (int i = 0; i < props.size(); ++i)
     {
-        gfx.renderSprite(gfx.getTexture(props[i].getTextureIndex()),props[i].getLoc(),props[i].getTextureDim(),props[i].getDim(),props[i].getCurrentFrame(),props[i].getTextureRow(),props[i].getXOrientation(),false,global_tint[(int)TIMESTOPCT_PROPS],2);
+        int slot = props.getSlot(i);
+        gfx.renderSprite(gfx.getTexture(props.getTextureIndex(slot)),props.getLoc(slot),props.getDim(slot),props.getDim(slot),props.getCurrentFrame(slot),props.getTextureRow(slot),props.getXOrientation(slot),false,global_tint[(int)TIMESTOPCT_PROPS],2);
     }
+    gfx.setSpriteLayer(SPRITELAYER_PLAYER);
     gfx.renderSprite(gfx.getTexture(player_mob.getTextureIndex()),player_mob.getLoc(),player_mob.getTextureDim(),player_mob.getDim(),player_mob.getCurrentFrame(),0,player_mob.getXOrientation(),false,global_tint[(int)TIMESTOPCT_PLAYER],2);
     // Make sure the player's weapon texture is placed directly *in front* of the player texture.
-    if (getPlayerMob()->getItemCarryType() != ITEMTYPE_NONE)
-        gfx.renderSprite(gfx.getTexture(getItemCarriedByMob(getPlayerMob()->entid())->getTextureIndex()),
-                                        getItemCarriedByMob(getPlayerMob()->entid())->getLoc(),
-                                        getItemCarriedByMob(getPlayerMob()->entid())->getTextureDim(),getItemCarriedByMob(getPlayerMob()->entid())->getDim(),
-                                        getItemCarriedByMob(getPlayerMob()->entid())->getCurrentFrame(),getWeaponModRow(getItemCarriedByMob(getPlayerMob()->entid())),
-                                        getItemCarriedByMob(getPlayerMob()->entid())->getXOrientation(),false,global_tint[(int)TIMESTOPCT_ITEMS],2);
-    for (int i = 0; i < (int)items.size(); ++i)
-    {
+    item *player_weapon = getItemCarriedByMob(getPlayerMob()->entid());
+    if (player_weapon != NULL)
+        gfx.renderSprite(gfx.getTexture(player_weapon->getTextureIndex()),player_weapon->getLoc(),player_weapon->getTextureDim(),player_weapon->getDim(),
+                         player_weapon->getCurrentFrame(),getWeaponModRow(player_weapon),player_weapon->getXOrientation(),false,global_tint[(int)TIMESTOPCT_ITEMS],2);
+    gfx.setSpriteLayer(SPRITELAYER_ITEMS);
+    for (int k = 0; k < (int)item_candidates.size(); ++k)
+    {
+        int i = item_candidates[k];
         // All equipped weapons already were rendered. Render the remaining weapons here.
         if (items[i].getPossessionMobID() == -1)
             gfx.renderSprite(gfx.getTexture(items[i].getTextureIndex()),items[i].getLoc(),items[i].getTextureDim(),items[i].getDim(),items[i].getCurrentFrame(),getWeaponModRow(&items[i]),items[i].getXOrientation(),false,global_tint[(int)TIMESTOPCT_ITEMS],2);
     }
-    for (int i = 0; i < (int)powerups.size(); ++i)
+    for (int k = 0; k < (int)powerup_candidates.size(); ++k)
     {
+        int i = powerup_candidates[k];
         gfx.renderSprite(gfx.getTexture(powerups[i].getTextureIndex()),powerups[i].getLoc(),powerups[i].getTextureDim(),powerups[i].getDim(),powerups[i].getCurrentFrame(),0,powerups[i].getXOrientation(),false,global_tint[(int)TIMESTOPCT_POWERUPS],2);
     }
     if (true) // current_level >= BOSS_LEVEL3)
     {
-        for (int i = 0; i < (int)npcs.size(); ++i)
+        gfx.setSpriteLayer(SPRITELAYER_SHADOWS);
+        for (int k = 0; k < (int)npc_candidates.size(); ++k)
         {
+            int i = npc_candidates[k];
             if (npcs[i].getMobSuperFields()->p_type == POWERTYPE_THROUGHWALLS)
             {
                 gfx.renderSprite(gfx.getTexture(npcs[i].getTextureIndex()),npcs[i].getLoc(),npcs[i].getTextureDim(),npcs[i].getDim(),npcs[i].getCurrentFrame(),getMobModRow(&npcs[i]),npcs[i].getXOrientation(),false,global_tint[(int)TIMESTOPCT_SHADOWS],2);
@@ -2466,17 +3153,25 @@ void Game::renderTextures()
             }
         }
     }
+    gfx.setSpriteLayer(SPRITELAYER_PARTICLES);
     for (int i = 0; i < (int)particles.size(); ++i)
          gfx.renderSprite(gfx.getTexture(particles[i].getTextureIndex()),particles[i].getLoc(),particles[i].getTextureDim(),particles[i].getDim(),particles[i].getCurrentFrame(),0,particles[i].getXOrientation(),false,global_tint[(int)TIMESTOPCT_PARTICLES],2);
     // Render status area at top (health, experience, score, level)
+    // (formatted into a buffer, so that an unchanged value costs no allocation)
+    char hud_text[MAX_TEXT_RUN_LENGTH + 1];
+    gfx.setSpriteLayer(SPRITELAYER_HUD);
     gfx.addBitmapCharacter(color_red,3,point(4.0,4.0));
-    gfx.addBitmapString(color_white,int2String(getPlayerMob()->getHP()) + "/" + int2String(getPlayerMob()->getMobSuperFields()->max_hp),point(25.0,4.0));
+    snprintf(hud_text,sizeof(hud_text),"%d/%d",getPlayerMob()->getHP(),getPlayerMob()->getMaxHP());
+    gfx.addBitmapString(color_white,hud_text,point(25.0,4.0));
     gfx.addBitmapCharacter(color_darkorange,(int)'E',point(4.0,20.0));
-    gfx.addBitmapString(color_white,int2String(exp_level) + "/" + uint2String(exp_points),point(25.0,20.0));
+    snprintf(hud_text,sizeof(hud_text),"%d/%u",exp_level,exp_points);
+    gfx.addBitmapString(color_white,hud_text,point(25.0,20.0));
     gfx.addBitmapCharacter(color_green,(int)'$',point(4.0,36.0));
-    gfx.addBitmapString(color_white,int2String(score),point(25.0,36.0));
+    snprintf(hud_text,sizeof(hud_text),"%d",score);
+    gfx.addBitmapString(color_white,hud_text,point(25.0,36.0));
     gfx.addBitmapCharacter(color_white,(int)'L',point(4.0,52.0));
-    gfx.addBitmapString(color_white,int2String(current_level),point(25.0,52.0));
+    snprintf(hud_text,sizeof(hud_text),"%d",current_level);
+    gfx.addBitmapString(color_white,hud_text,point(25.0,52.0));
     // Show inventory right below status area
     for (int i = 0; i < (int)player_inventory.size(); ++i)
     {
@@ -2489,10 +3184,140 @@ void Game::renderTextures()
     }
     renderWeaponSkillPanel();
     renderNPCNameStatusIndicator();
+    if (profiler.overlayVisible())
+        renderProfilerOverlay();
     // call SDL_RenderPresent
     gfx.updateScreen();
 }
 
+void Game::markStaticLayersDirty()
+{
+    static_layers_dirty = true;
+}
+
+// The static layer chunks are render targets, whose contents are lost when the
+// renderer resets its targets (i.e. after a D3D device loss). Bake them again, into
+// new chunks if the whole device was reset, after uploading the textures again
+// (a device reset loses every texture).
+void Game::checkRendererReset()
+{
+    if (evt_handler.renderDeviceReset())
+    {
+        gfx.reloadTextures();
+        gfx.discardStaticLayers();
+    }
+
+    if (evt_handler.renderTargetsReset() || evt_handler.renderDeviceReset())
+        markStaticLayersDirty();
+}
+
+// Draw every static layer sprite into the chunks it overlaps
+void Game::bakeStaticLayers()
+{
+    static_layers_dirty = false;
+    static_layers_baked = gfx.initStaticLayers(current_level_size);
+
+    if (!static_layers_baked)
+        return;
+
+    gfx.beginStaticLayerBake();
+    for (int l = 0; l < NUM_STATIC_LAYERS; ++l)
+    for (int i = 0; i < gfx.getNumStaticChunks(); ++i)
+    {
+        gfx.beginStaticChunk((static_layer)l,i);
+        renderStaticSprites((static_layer)l,gfx.getStaticChunkLoc(i),gfx.getStaticChunkLoc(i) + gfx.getStaticChunkDim());
+    }
+    gfx.endStaticLayerBake();
+}
+
+// Render the sprites of static layer "layer" that overlap the area minp..maxp (level coordinates).
+// Everything in a layer keeps the same position, texture and tint until the layer is marked dirty.
+void Game::renderStaticSprites(static_layer layer, point minp, point maxp)
+{
+    if (layer == STATICLAYER_BELOW_DOORS)
+    {
+        gfx.setSpriteLayer(SPRITELAYER_STATIC_BELOW_DOORS);
+        for (int i = 1; i < numBackdrops(); ++i)
+        {
+            if (isEntityInArea(&backdrops[i],minp,maxp))
+                gfx.renderSprite(gfx.getTexture(backdrops[i].getTextureIndex()),backdrops[i].getLoc(),backdrops[i].getTextureDim(),backdrops[i].getDim(),0,0,SDL_FLIP_NONE,false,global_tint[(int)TIMESTOPCT_BACKDROP],2);
+        }
+        for (int i = 0; i < (int)static_props.size(); ++i)
+        {
+            if (isEntityInArea(&static_props[i],minp,maxp))
+                gfx.renderSprite(gfx.getTexture(static_props[i].getTextureIndex()),static_props[i].getLoc(),static_props[i].getTextureDim(),static_props[i].getDim(),0,0,SDL_FLIP_NONE,false,global_tint[(int)TIMESTOPCT_STATICPROPS],2);
+        }
+        for (int i = 0; i < (int)switches.size(); ++i)
+        {
+            if (isEntityInArea(&switches[i],minp,maxp))
+                gfx.renderSprite(gfx.getTexture(switches[i].getTextureIndex()),switches[i].getLoc(),switches[i].getTextureDim(),switches[i].getDim(),0,0,SDL_FLIP_NONE,false,global_tint[(int)TIMESTOPCT_SWITCHES],2);
+        }
+    }
+    else
+    {
+        gfx.setSpriteLayer(SPRITELAYER_STATIC_ABOVE_DOORS);
+        for (int i = 0; i < (int)numWallBlocks(); ++i)
+        {
+            if (isEntityInArea(&walls[i],minp,maxp))
+                gfx.renderSprite(gfx.getTexture(walls[i].getTextureIndex()),walls[i].getLoc(),walls[i].getTextureDim(),walls[i].getDim(),0,0,SDL_FLIP_NONE,false,getWallColor(i),2);
+        }
+        for (int i = 0; i < (int)ladders.size(); ++i)
+        {
+            if (isEntityInArea(&ladders[i],minp,maxp))
+                gfx.renderSprite(gfx.getTexture(ladders[i].getTextureIndex()),ladders[i].getLoc(),ladders[i].getTextureDim(),ladders[i].getDim(),0,0,SDL_FLIP_NONE,false,ladders[i].getLadderTint(),2);
+        }
+    }
+}
+
+// Per phase frame times (last frame, mean and p99 over the profiler history), toggled with F3
+void Game::renderProfilerOverlay()
+{
+    // nothing to show before the first frame has ended
+    if (profiler.getNumFrames() == 0)
+        return;
+
+    profile_frame last_frame = profiler.getFrame(profiler.getNumFrames() - 1);
+    double y_loc = 100.0;
+
+    gfx.addBitmapString(color_yellow,"phase             last  mean   p99",point(4.0,y_loc));
+
+    for (int i = 0; i < NUM_PROFILE_PHASES; ++i)
+    {
+        profile_phase_stats stats = profiler.getPhaseStats((profile_phase)i);
+        std::string phase_name = getProfilePhaseName((profile_phase)i);
+        phase_name.resize(16,' ');
+        y_loc += FONT_CHAR_HEIGHT;
+        gfx.addBitmapString(color_white,phase_name + formatProfileTime(last_frame.phase_ms[i]) + formatProfileTime(stats.mean_ms) + formatProfileTime(stats.p99_ms),point(4.0,y_loc));
+    }
+
+    y_loc += FONT_CHAR_HEIGHT;
+
+    for (int i = 0; i < NUM_PROFILE_COUNTERS; ++i)
+    {
+        y_loc += FONT_CHAR_HEIGHT;
+        gfx.addBitmapString(color_green,getProfileCounterName((profile_counter)i) + ": " + int2String(last_frame.counters[i]),point(4.0,y_loc));
+    }
+}
+
+void Game::recordProfilerCounts()
+{
+    profiler.setCounter(PROFCOUNT_NPCS,(int)npcs.size());
+    profiler.setCounter(PROFCOUNT_PROPS,props.size());
+    profiler.setCounter(PROFCOUNT_PARTICLES,(int)particles.size());
+    profiler.setCounter(PROFCOUNT_WALLS,(int)walls.size());
+    profiler.setCounter(PROFCOUNT_WALLRECTS,(int)wall_rects.size());
+    profiler.setCounter(PROFCOUNT_DELETIONS,num_deleted_entities);
+    profiler.setCounter(PROFCOUNT_LEVELHEAPALLOCS,num_level_allocations);
+    profiler.setCounter(PROFCOUNT_SPRITESDRAWN,gfx.getNumSpritesDrawn());
+    profiler.setCounter(PROFCOUNT_SPRITESCULLED,gfx.getNumSpritesCulled());
+    profiler.setCounter(PROFCOUNT_DRAWCALLS,gfx.getNumDrawCalls());
+}
+
+bool Game::dumpProfile(std::string file_name)
+{
+    return profiler.writeCSV(file_name);
+}
+
 void Game::renderWeaponSkillPanel()
 {
     int y_iter = 0;
@@ -2500,14 +3325,16 @@ void Game::renderWeaponSkillPanel()
     point tile_dim;
     point tile_loc;
     point str_loc;
+    char bonus_text[16];
     for (int i = 0; i < NUM_WEAPON_TYPES; ++i) {
          if (weapon_exp_bonus[i] > 0) {
              damage_bonus = weapon_exp_bonus[i] * weapon_bonus_level_damage_multipliers[i];
              tile_dim = item_data[i+1].idef.dimensions;
-             tile_loc = multPoints(point(0.5,0.5),point((double)WINDOW_WIDTH - 94.0 + (33.0 - tile_dim.x()),8.0 + (y_iter * 24.0) + (18.0 - tile_dim.y())));
+             tile_loc = point(0.5,0.5) * point((double)WINDOW_WIDTH - 94.0 + (33.0 - tile_dim.x()),8.0 + (y_iter * 24.0) + (18.0 - tile_dim.y()));
              str_loc = point((double)WINDOW_WIDTH - 54.0,8.0 + (y_iter * 24.0));
              gfx.renderSprite(gfx.getTexture(weapon_texture_indices[i]),tile_loc,tile_dim,tile_dim,0,0,SDL_FLIP_NONE,true,color_black,1);
-             gfx.addBitmapString(color_white,"+" + int2String(damage_bonus),str_loc);
+             snprintf(bonus_text,sizeof(bonus_text),"+%d",damage_bonus);
+             gfx.addBitmapString(color_white,bonus_text,str_loc);
              y_iter++;
          }
     }
@@ -2515,14 +3342,16 @@ void Game::renderWeaponSkillPanel()
 
 void Game::renderNPCNameStatusIndicator()
 {
-    std::string name_ind;
+    char name_ind[MAX_TEXT_RUN_LENGTH + 1];
     SDL_Color color;
     point loc;
-    if (npcTargetFocusID >= 1)
+    mob *target = (npcTargetFocusID >= 1 ? getMobFromEntityID(npcTargetFocusID) : NULL);
+    if (target != NULL)
     {
-        name_ind = getMobFromEntityID(npcTargetFocusID)->getName() + " " + int2String(getMobFromEntityID(npcTargetFocusID)->getHP()) + "/" + int2String(getMobFromEntityID(npcTargetFocusID)->getMobSuperFields()->max_hp);
-        loc = point(WINDOW_WIDTH/2.0-16.0*(double)((int)name_ind.size()/2),8.0);
-        switch(getMobFromEntityID(npcTargetFocusID)->getMobModifierType())
+        int length = snprintf(name_ind,sizeof(name_ind),"%s %d/%d",target->getName().c_str(),target->getHP(),target->getMaxHP());
+        length = std::min(length,(int)sizeof(name_ind) - 1);
+        loc = point(WINDOW_WIDTH/2.0-16.0*(double)(length/2),8.0);
+        switch(target->getMobModifierType())
         {
             case(MOBMODIFIER_NONE):
                 color = color_white;
@@ -2548,10 +3377,10 @@ void Game::renderNPCNameStatusIndicator()
 // The bar is scaled to the length of the sprite and color changes from green-yellow-orange-red smoothly.
 void Game::printNPCHealthBar(mob *mb)
 {
-    if (mb->getHP() < mb->getMobSuperFields()->max_hp && !mb->isDead()) {
-        double hp_ratio = (double)mb->getHP()/(double)mb->getMobSuperFields()->max_hp;
+    if (mb->getHP() < mb->getMaxHP() && !mb->isDead()) {
+        double hp_ratio = (double)mb->getHP()/(double)mb->getMaxHP();
         Uint8 shade = (Uint8)((int)(hp_ratio*255.0));
-        gfx.drawRectangle({(Uint8)(255-(shade/3)),shade,0,0},addPoints(mb->getLoc(),point(0.0,-3.0)),point(hp_ratio*mb->getDim().x(),2.0));
+        gfx.drawRectangle({(Uint8)(255-(shade/3)),shade,0,0},mb->getLoc() + point(0.0,-3.0),point(hp_ratio*mb->getDim().x(),2.0));
     }
 }
 
@@ -2562,10 +3391,7 @@ void Game::updateAnimations() {
              it->animate(0,it->getNumFrames()-1);
     }
 
-    for (auto it = props.begin(); it != props.end(); ++it) {
-         if (it->getPhysicsStatus() == PHYSTYPE_FULL)
-             it->animate(0, it->getNumFrames()-1);
-    }
+    props.animateProps();
 
     for (auto it = items.begin(); it != items.end(); ++it) {
          if (eitherFromPlayerOrTimeActive(it->getPossessionMobID()))
@@ -2597,8 +3423,11 @@ void Game::updateItemTimers()
 // or possibly dock door at final closed or open position.
 void Game::updateDoorTimers()
 {
-    for (auto it = doors.begin(); it != doors.end(); ++it)
-         it->activateDoor();
+    for (int i = 0; i < (int)doors.size(); ++i)
+    {
+         doors[i].activateDoor();
+         door_grid.move(i, doors[i].getLoc(), doors[i].getMaxLoc());
+    }
 }
 
 // Wall blocks include level boundaries (indices 0-3)...
@@ -2626,6 +3455,8 @@ mob* Game::getPlayerMob()
 // 2 -> yellow
 void Game::setWallColorTint()
 {
+    markStaticLayersDirty();
+
     switch(3)
     {
         case(0):
@@ -2657,6 +3488,8 @@ void Game::setWallColorTint()
 // 2 -> yellow
 void Game::setLadderColorTint()
 {
+    markStaticLayersDirty();
+
     switch(0)
     {
         case(0):
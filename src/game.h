@@ -10,6 +10,10 @@
 #include "entity.h"
 #include "generate.h"
 #include "menu.h"
+#include "profiler.h"
+#include "spatial.h"
+#include "proppool.h"
+#include "allocstats.h"
 
 #define MAX_PLAYER_EXP_LEVEL 76
 
@@ -24,6 +28,9 @@
 
 #define NUM_TIMESTOPPED_COLOR_VARIATION 14
 
+// extra room around the camera when looking up npcs, items and powerups to draw
+#define RENDER_CULL_MARGIN 40.0
+
 // refactor into enumerated values
 static const int weapon_texture_indices[NUM_WEAPON_TYPES] =
 {
@@ -345,11 +352,34 @@ static const uint exp_levelup_values[MAX_PLAYER_EXP_LEVEL - 1] =
     3000000000
 };
 
+// A mob in the path of a bullet
+struct bullet_hit
+{
+    double dist;
+    int order;
+    mob *target;
+};
+
 class Game
 {
 public:
     Game();
     void run();
+    bool startEngines();
+    bool finishAssetLoading(bool);
+    void printStartupTimes();
+    void runHeadless(int);
+    void setSeed(unsigned int);
+    unsigned int getSeed();
+    void reseed();
+    // benchmark scenarios (see tools/benchmark.cpp)
+    void initBenchmarkLevel(int);
+    void fillLevelWithNPCs();
+    void equipPlayerWeapon(item_type);
+    void runBenchmarkTicks(int, bool);
+    void runMapGenerationSweep(int);
+    frame_profiler *getProfiler();
+    void simulateFrame();
     void initLevelObjects();
     void initGameStats();
     void initLevelMapSize(int);
@@ -357,21 +387,31 @@ public:
     void pollInput();
     void processActions();
     void renderTextures();
+    void markStaticLayersDirty();
+    void checkRendererReset();
+    void bakeStaticLayers();
+    void renderStaticSprites(static_layer, point, point);
     void renderWeaponSkillPanel();
     void updateAnimations();
     void delayGame();
     void cleanupLevelData();
+    void reserveLevelStorage();
+    void beginLevelLoad();
+    void endLevelLoad();
     void applyAI();
     void settleMobsToGround();
     void applyPhysics();
+    void deleteMarkedEntities();
     void applyPhysicsForItem(item *);
     void applyPhysicsForDynamicEntity(dynamic_entity*);
     void applyPhysicsForShadowEntity(mob *, dynamic_entity*);
-    void applyHorizontalAcceleration(dynamic_entity*);
-    void applyHorizontalResistance(dynamic_entity*);
-    void applyGravity(dynamic_entity*);
+    // static so the physics kernel self test can run them on its own entities
+    static void applyHorizontalAcceleration(dynamic_entity*);
+    static void applyHorizontalResistance(dynamic_entity*);
+    static void applyGravity(dynamic_entity*);
+    static void offsetEntityLoc(dynamic_entity*);
     void applyCollisions(dynamic_entity*);
-    void offsetEntityLoc(dynamic_entity*);
+    void applyPropCollisions(int);
     void createShadowExplosions(mob *);
     void dropKey(mob *);
     void npcWeaponEvent(mob *);
@@ -401,6 +441,8 @@ public:
     mob * getMobCarryingItem(int);
     mob * getMobFromEntityID(int);
     item * getItemCarriedByMob(int);
+    item * getItemFromEntityID(int);
+    void rebuildNPCIndexTable();
     bool isBoss(mob_type);
     bool checkPickupEvent(mob *, item *);
     bool checkDropEvent(mob *, item *);
@@ -413,8 +455,8 @@ public:
     void levelUpPlayer();
     void damageMob(mob *, int, int, item_type);
     void setDeathType(mob*, item_type, int);
-    bool projectileDrawerCollidingWithMob(mob *, point);
-    bool projectileDrawerHitWall(point);
+    void fireBulletRay(mob *, point, double);
+    double getBulletWallDistance(point, double);
     bool mobFacingTarget(mob *, mob *);
     bool eitherFromPlayerOrTimeActive(int);
     int numBackdrops();
@@ -432,6 +474,11 @@ public:
     void updateDoorTimers();
     bool destroyParticleCondition(particle *);
     bool isCollidingWithStaticBlocker(point,point);
+    void buildStaticBlockerGrid();
+    void mergeWallTiles();
+    bool isCollidingWithWallRect(point,point);
+    void markBroadphaseDirty();
+    void updateBroadphase();
     void checkStaticEntityDestruction();
     void createExplosion(point,int,int,double, item_type);
     void applyMobDeathKnockback(mob *, item_type);
@@ -476,15 +523,38 @@ public:
 
     void executeGamePauseActions();
 
+    void recordProfilerCounts();
+    void renderProfilerOverlay();
+    bool dumpProfile(std::string);
+
     SDL_Color getLadderColor();
     SDL_Color getWallColor(int);
 
 private:
+    // mapped asset bundle (declared before gfx and sfx, so it is unmapped after the
+    // sounds that use its samples are freed)
+    asset_bundle bundle;
+    bool textures_from_bundle;
+    bool sounds_from_bundle;
     gfx_engine gfx;
     snd_engine sfx;
+    // decodes textures and sounds while the main menu is up (declared after gfx and
+    // sfx, so it is destroyed, and done with the workers, before them)
+    asset_loader asset_pool;
+    bool assets_ready;
+    bool assets_loaded;
+    // startup breakdown (see printStartupTimes)
+    Uint64 startup_counter;
+    double startup_sdl_ms;
+    double startup_mixer_ms;
+    double startup_bundle_ms;
+    double startup_upload_ms;
+    double startup_menu_ms;
     input evt_handler;
     std::vector<entity> backdrops;
     std::vector<static_entity> walls;
+    // walls merged into as few rectangles as possible (see mergeWallTiles)
+    std::vector<static_entity> wall_rects;
     std::vector<static_entity> static_props;
     std::vector<Ladder> ladders;
     std::vector<toggle_switch> switches;
@@ -492,9 +562,39 @@ private:
     std::vector<mob> npcs;
     std::vector<item> items;
     std::vector<item> powerups;
-    std::vector<dynamic_entity> props;
+    prop_pool props;
     std::vector<particle> particles;
     std::vector<item> player_inventory;
+    // npc entity id -> index in npcs (see rebuildNPCIndexTable)
+    std::vector<int> npc_index_from_id;
+    // walls and doors indexed by tile (built in generateMap)
+    tile_grid wall_grid;
+    tile_grid wall_rect_grid;
+    tile_grid door_grid;
+    // map generator of every level load (its grids are reused)
+    terrain_map level_generator;
+    std::vector<int> blocker_candidates;
+    // npcs, items and powerups by location (rebuilt when something moved, see updateBroadphase)
+    spatial_hash npc_hash;
+    spatial_hash item_hash;
+    spatial_hash powerup_hash;
+    bool broadphase_dirty;
+    // static layer chunks need to be redrawn (new level or tint change)
+    bool static_layers_dirty;
+    // false if the renderer has no render targets (static sprites are drawn every frame)
+    bool static_layers_baked;
+    std::vector<int> npc_candidates;
+    std::vector<int> item_candidates;
+    std::vector<int> powerup_candidates;
+    std::vector<bullet_hit> bullet_hits;
+    // cannonballs and rockets destroyed this frame (they explode after compaction)
+    std::vector<particle> explosion_sources;
+    // entities removed by the last deleteMarkedEntities call
+    int num_deleted_entities;
+    // allocation count when the current level load started
+    Uint64 level_load_start_allocations;
+    // heap allocations made by the last level load
+    int num_level_allocations;
     mob player_mob;
     //mob test_knight;
     bool quit_flag;
@@ -515,6 +615,9 @@ private:
     Uint32 frames_per_second;
     Uint32 frame_start_timer;
     menu main_menu;
+    frame_profiler profiler;
+    std::mt19937 rng_engine;
+    unsigned int game_seed;
     SDL_Color global_tint[NUM_TIMESTOPPED_COLOR_VARIATION];
     SDL_Color color_wall_tint;
     SDL_Color color_ladder_tint;
@@ -538,6 +641,10 @@ point getParticleStartVelocity(particle_type, bool);
 
 point getParticleInsertLoc(item *, particle_type, bool);
 
+double getRayEntryDistance(point, double, entity *);
+bool compareBulletHits(bullet_hit, bullet_hit);
+bool isMarkedForDeletion(dynamic_entity &);
+
 bool npcDetectCondition(mob *, mob *);
 bool npcAttackCondition(mob *, mob *);
 bool isBossLevel(int);
@@ -9,11 +9,9 @@ maze::maze() {}
 void maze::initMaze(point ms) {
     // Store maze dimensions (odd x, odd y) into maze size member variable
     maze_size = ms;
-    // Resize 2D vector of maze_unit_type to maze_size.x() by maze_size.y()
-    // and initialize all values to MAZE_WALL
-    // maze_size.x() is used as outer dimension so that array access goes by [x][y] so that
-    // x comes first.
-    maze_array.resize(maze_size.x(), std::vector<maze_unit_type>(maze_size.y(), MAZE_WALL));
+    // One bit per unit, stored row by row (see getUnitIndex),
+    // all initialized to MAZE_WALL
+    maze_walls.assign((int)maze_size.x() * (int)maze_size.y(), true);
 
     // make maze have trapped MAZE_EMPTY tiles
     // i.e. make maze look like:
@@ -29,23 +27,24 @@ void maze::initMaze(point ms) {
     //   odd y
     // where "#" is MAZE_WALL and
     // where " " is MAZE_EMPTY
-    for (int x = 0; x < maze_size.x(); ++x)
     for (int y = 0; y < maze_size.y(); ++y)
+    for (int x = 0; x < maze_size.x(); ++x)
     {
         // modulo condition that yields empty maze tile positions
-        if (x % 2 != 0 && y % 2 != 0)
-            maze_array[x][y] = MAZE_EMPTY;
-        else
-            maze_array[x][y] = MAZE_WALL;
+        maze_walls[getUnitIndex(x,y)] = !(x % 2 != 0 && y % 2 != 0);
     }
     // make point(0,0) be a MAZE_WALL (blocked wall tile) to finish the job.
     // since the modulo condition ignores (0,0)
-    maze_array[0][0] = MAZE_WALL;
+    maze_walls[0] = true;
 }
 
-// Clear and free memory of maze_array
+// Clear and free memory of maze_walls
 void maze::cleanupMaze() {
-    std::vector < std::vector < maze_unit_type > >().swap(maze_array);
+    std::vector < bool >().swap(maze_walls);
+}
+
+int maze::getUnitIndex(int x, int y) {
+    return y * (int)maze_size.x() + x;
 }
 
 // num guaranteed maze floors are num maze floors before carving is done.
@@ -104,7 +103,7 @@ bool maze::anyAdjacentTrapped(point current_dig, point u, point d, point l, poin
 // use stack method to create maze (one path solution)
 void maze::build()
 {
-    std::stack <point> unit_stack;
+    dig_stack.clear();
     point current_dig = point(randZero((int)( (maze_size.x() - 1) / 2) - 1) * 2 + 1,randZero((int)( (maze_size.y() - 1) / 2) - 1) * 2 + 1);
     start_dig = current_dig;
     int num_visited = 1;
@@ -114,14 +113,14 @@ void maze::build()
         setAdjacentPoints(current_dig,u,d,l,r);
         if (anyAdjacentTrapped(current_dig,u,d,l,r)) {
             digIntoMazeWall(direction, selected, knock, u, d, l, r);
-            maze_array[knock.x()][knock.y()] = MAZE_EMPTY;
-            unit_stack.push(current_dig);
+            maze_walls[getUnitIndex(knock.x(),knock.y())] = false;
+            dig_stack.push_back(current_dig);
             current_dig = selected;
             num_visited++;
         }
         else {
-            new_dig = unit_stack.top();
-            unit_stack.pop();
+            new_dig = dig_stack.back();
+            dig_stack.pop_back();
             current_dig = new_dig;
         }
     }
@@ -130,16 +129,15 @@ void maze::build()
 // test for trapped cell (used by build function for determining whether or
 // not we should dig here.
 bool maze::isUnitTrapped(point p) {
-    point a;
+    int px = (int)p.x();
+    int py = (int)p.y();
 
-    for (int x = p.x() - 1; x <= p.x() + 1; ++x)
-    for (int y = p.y() - 1; y <= p.y() + 1; ++y)
+    for (int y = py - 1; y <= py + 1; ++y)
+    for (int x = px - 1; x <= px + 1; ++x)
     {
-        a.set(x,y);
-
-        if (x != p.x() || y != p.y())
-        if (inRange(a,point(0.0,0.0),point(maze_size.x()-1,maze_size.y()-1)))
-        if (maze_array[x][y] != MAZE_WALL)
+        if (x != px || y != py)
+        if (x >= 0 && y >= 0 && x < (int)maze_size.x() && y < (int)maze_size.y())
+        if (!maze_walls[getUnitIndex(x,y)])
             return false;
 
     }
@@ -152,12 +150,12 @@ maze_dig_direction maze::pickDigDirection() {
 
 // get unit
 maze_unit_type maze::getUnit(point p) {
-    return maze_array[p.x()][p.y()];
+    return (maze_walls[getUnitIndex(p.x(),p.y())] ? MAZE_WALL : MAZE_EMPTY);
 }
 
 // set unit to...
 void maze::setUnit(point p, maze_unit_type mut) {
-    maze_array[p.x()][p.y()] = mut;
+    maze_walls[getUnitIndex(p.x(),p.y())] = (mut == MAZE_WALL);
 }
 
 point maze::getMazeSize() {
@@ -174,15 +172,35 @@ terrain_map::terrain_map()
 
 void terrain_map::cleanupTerrainMap()
 {
-    std::vector < std::vector < terrain_struct > >().swap(terrain_vec);
+    std::vector < Uint8 >().swap(cell_types);
+    std::vector < Uint8 >().swap(cell_styles);
+    std::vector < terrain_style >().swap(style_table);
 }
 
 void terrain_map::setTerrainStruct(point loc, point sze, terrain_type t_type, int tid, int cid)
 {
-    terrain_vec[loc.y()][loc.x()].t_type = t_type;
-    terrain_vec[loc.y()][loc.x()].sze = sze;
-    terrain_vec[loc.y()][loc.x()].tid = tid;
-    terrain_vec[loc.y()][loc.x()].cid = cid;
+    int i = getCellIndex(loc.x(),loc.y());
+    cell_types[i] = (Uint8)t_type;
+    cell_styles[i] = (Uint8)getStyleIndex(sze,tid,cid);
+}
+
+// cells are stored row by row
+int terrain_map::getCellIndex(int x, int y)
+{
+    return y * (int)dim.x() + x;
+}
+
+// Index of the style table entry (sze,tid,cid), added if it is not there yet
+int terrain_map::getStyleIndex(point sze, int tid, int cid)
+{
+    for (int i = 0; i < (int)style_table.size(); ++i)
+    {
+        if (style_table[i].tid == tid && style_table[i].cid == cid && isAt(style_table[i].sze,sze))
+            return i;
+    }
+    terrain_style style = {sze,tid,cid};
+    style_table.push_back(style);
+    return (int)style_table.size() - 1;
 }
 
 /*
@@ -230,9 +248,9 @@ void terrain_map::squishLadderEndPlatforms() {
     for (int x = 0; x < (int)dim.x(); ++x)
     {
         if (y > 1 && x > 0 && x < (int)dim.x() - 1 && y < (int)dim.y() - 2) {
-            current_tile = getTerrainStruct(point(x,y)).t_type;
-            upper_tile = getTerrainStruct(point(x,y - 1)).t_type;
-            lower_tile = getTerrainStruct(point(x,y + 1)).t_type;
+            current_tile = getTerrainType(x,y);
+            upper_tile = getTerrainType(x,y - 1);
+            lower_tile = getTerrainType(x,y + 1);
 
             if (current_tile == TERRAINTYPE_WALL && lower_tile == TERRAINTYPE_LADDER &&
                (upper_tile < (int)TERRAINTYPE_DOOR && lower_tile < (int)TERRAINTYPE_DOOR))
@@ -243,20 +261,17 @@ void terrain_map::squishLadderEndPlatforms() {
 
 void terrain_map::buildMaze(point m_sze)
 {
-    maze mze_obj;
-    mze_obj.initMaze(m_sze);
-    mze_obj.build();
+    level_maze.initMaze(m_sze);
+    level_maze.build();
 
     for (int y = 0; y < (int)dim.y(); ++y)
     for (int x = 0; x < (int)dim.x(); ++x)
     {
-        if (mze_obj.getUnit(point(x,y)) == MAZE_WALL)
+        if (level_maze.getUnit(point(x,y)) == MAZE_WALL)
             setTerrainStruct(point(x,y),point(SMALL_BLOCK_DIM, SMALL_BLOCK_DIM),TERRAINTYPE_WALL,15,0);
         else
             setTerrainStruct(point(x,y),point(0.0,0.0),TERRAINTYPE_EMPTY,0,0);
     }
-
-    mze_obj.cleanupMaze();
 }
 
 void terrain_map::addItems()
@@ -264,11 +279,11 @@ void terrain_map::addItems()
     for (int y = 1; y < (int)dim.y() - 1; ++y)
     for (int x = 1; x < (int)dim.x() - 1; ++x)
     {
-        if(getTerrainStruct(point(x,y+1)).t_type == TERRAINTYPE_WALL &&
-           getTerrainStruct(point(x,y)).t_type == TERRAINTYPE_EMPTY &&
-           getTerrainStruct(point(x+1,y+1)).t_type != TERRAINTYPE_WALL &&
-           getTerrainStruct(point(x-1,y+1)).t_type != TERRAINTYPE_WALL &&
-           getTerrainStruct(point(x,y-1)).t_type != TERRAINTYPE_BIGDOOR)
+        if(getTerrainType(x,y+1) == TERRAINTYPE_WALL &&
+           getTerrainType(x,y) == TERRAINTYPE_EMPTY &&
+           getTerrainType(x+1,y+1) != TERRAINTYPE_WALL &&
+           getTerrainType(x-1,y+1) != TERRAINTYPE_WALL &&
+           getTerrainType(x,y-1) != TERRAINTYPE_BIGDOOR)
         {
             if (!roll(29))
                 setTerrainStruct(point(x,y),point(0.0,0.0),TERRAINTYPE_ITEMPLACEHOLDER,0,0);
@@ -280,15 +295,15 @@ void terrain_map::addItems()
     for (int y = 2; y < (int)dim.y() - 2; ++y)
     for (int x = 2; x < (int)dim.x() - 2; ++x)
     {
-        if(getTerrainStruct(point(x,y+1)).t_type == TERRAINTYPE_WALL &&
-           getTerrainStruct(point(x,y)).t_type == TERRAINTYPE_EMPTY &&
-           getTerrainStruct(point(x+1,y+1)).t_type == TERRAINTYPE_WALL &&
-           getTerrainStruct(point(x-1,y+1)).t_type == TERRAINTYPE_WALL &&
-           getTerrainStruct(point(x+2,y+1)).t_type == TERRAINTYPE_EMPTY &&
-           getTerrainStruct(point(x-2,y+1)).t_type == TERRAINTYPE_EMPTY &&
-           getTerrainStruct(point(x+1,y)).t_type == TERRAINTYPE_EMPTY &&
-           getTerrainStruct(point(x-1,y)).t_type == TERRAINTYPE_EMPTY &&
-           getTerrainStruct(point(x,y-1)).t_type != TERRAINTYPE_BIGDOOR)
+        if(getTerrainType(x,y+1) == TERRAINTYPE_WALL &&
+           getTerrainType(x,y) == TERRAINTYPE_EMPTY &&
+           getTerrainType(x+1,y+1) == TERRAINTYPE_WALL &&
+           getTerrainType(x-1,y+1) == TERRAINTYPE_WALL &&
+           getTerrainType(x+2,y+1) == TERRAINTYPE_EMPTY &&
+           getTerrainType(x-2,y+1) == TERRAINTYPE_EMPTY &&
+           getTerrainType(x+1,y) == TERRAINTYPE_EMPTY &&
+           getTerrainType(x-1,y) == TERRAINTYPE_EMPTY &&
+           getTerrainType(x,y-1) != TERRAINTYPE_BIGDOOR)
         {
             if (!roll(4))
                 setTerrainStruct(point(x,y),point(0.0,0.0),TERRAINTYPE_ITEMPLACEHOLDER,0,0);
@@ -302,10 +317,10 @@ void terrain_map::eraseTopWalls()
 {
     for (int x = 1; x < (int)dim.x() - 1; ++x)
     {
-        if (getTerrainStruct(point(x,1)).t_type == TERRAINTYPE_WALL &&
-            getTerrainStruct(point(x,2)).t_type != TERRAINTYPE_BIGDOOR &&
-            getTerrainStruct(point(x,3)).t_type != TERRAINTYPE_BIGDOOR &&
-            getTerrainStruct(point(x,2)).t_type != TERRAINTYPE_DOOR)
+        if (getTerrainType(x,1) == TERRAINTYPE_WALL &&
+            getTerrainType(x,2) != TERRAINTYPE_BIGDOOR &&
+            getTerrainType(x,3) != TERRAINTYPE_BIGDOOR &&
+            getTerrainType(x,2) != TERRAINTYPE_DOOR)
         {
             setTerrainStruct(point(x,1),point(0.0,0.0),TERRAINTYPE_EMPTY,0,0);
         }
@@ -326,13 +341,13 @@ void terrain_map::makeEdgesEmpty()
 
 void terrain_map::connectLadderChains()
 {
-    for (int x = 0; x < (int)dim.x(); ++x)
+    for (int y = 1; y < (int)dim.y() - 1; ++y)
     {
-        for (int y = 1; y < (int)dim.y() - 1; ++y)
+        for (int x = 0; x < (int)dim.x(); ++x)
         {
-            if (getTerrainStruct(point(x,y)).t_type == TERRAINTYPE_WALL &&
-                getTerrainStruct(point(x,y+1)).t_type == TERRAINTYPE_LADDER &&
-                getTerrainStruct(point(x,y-1)).t_type == TERRAINTYPE_LADDER)
+            if (getTerrainType(x,y) == TERRAINTYPE_WALL &&
+                getTerrainType(x,y+1) == TERRAINTYPE_LADDER &&
+                getTerrainType(x,y-1) == TERRAINTYPE_LADDER)
                 {
                     setTerrainStruct(point(x,y),point(12.0,40.0),TERRAINTYPE_LADDER,16,0);
                 }
@@ -342,11 +357,11 @@ void terrain_map::connectLadderChains()
 
 void terrain_map::condenseWallCount()
 {
-    for (int x = 1; x < (int)dim.x() - 1; ++x)
     for (int y = 1; y < (int)dim.y() - 1; ++y)
+    for (int x = 1; x < (int)dim.x() - 1; ++x)
     {
-        if(getTerrainStruct(point(x,y)).t_type == TERRAINTYPE_WALL &&
-           getTerrainStruct(point(x+1,y)).t_type == TERRAINTYPE_WALL &&
+        if(getTerrainType(x,y) == TERRAINTYPE_WALL &&
+           getTerrainType(x+1,y) == TERRAINTYPE_WALL &&
            isAt(getTerrainStruct(point(x,y)).sze,point(40.0,40.0)) &&
            isAt(getTerrainStruct(point(x+1,y)).sze,point(40.0,40.0)))
         {
@@ -358,8 +373,8 @@ void terrain_map::condenseWallCount()
     for (int y = 1; y < (int)dim.y() - 1; ++y)
     for (int x = 1; x < (int)dim.x() - 1; ++x)
     {
-        if(getTerrainStruct(point(x,y)).t_type == TERRAINTYPE_WALL &&
-           getTerrainStruct(point(x,y+1)).t_type == TERRAINTYPE_WALL &&
+        if(getTerrainType(x,y) == TERRAINTYPE_WALL &&
+           getTerrainType(x,y+1) == TERRAINTYPE_WALL &&
            isAt(getTerrainStruct(point(x,y)).sze,point(40.0,40.0)) &&
            isAt(getTerrainStruct(point(x,y+1)).sze,point(40.0,40.0)))
         {
@@ -385,9 +400,9 @@ void terrain_map::addKeys(int lev)
         do
         {
           key_loc.set(randInt(1,dim.x()-2),randInt(1,dim.y()-2));
-        } while (!(getTerrainStruct(key_loc).t_type == TERRAINTYPE_EMPTY &&
-                   getTerrainStruct(point(key_loc.x(),key_loc.y()+1)).t_type == TERRAINTYPE_WALL &&
-                   getTerrainStruct(point(key_loc.x(),key_loc.y()-1)).t_type != TERRAINTYPE_BIGDOOR));
+        } while (!(getTerrainType(key_loc.x(),key_loc.y()) == TERRAINTYPE_EMPTY &&
+                   getTerrainType(key_loc.x(),key_loc.y()+1) == TERRAINTYPE_WALL &&
+                   getTerrainType(key_loc.x(),key_loc.y()-1) != TERRAINTYPE_BIGDOOR));
         setTerrainStruct(key_loc,point(0.0,0.0),TERRAINTYPE_KEY,0,0);
     }
 }
@@ -397,8 +412,8 @@ void terrain_map::addLadderPoints()
     for (int y = (int)dim.y() - 2; y >= 1; --y)
     for (int x = 1; x <= (int)dim.x() - 2; ++x)
     {
-        if (getTerrainStruct(point(x,y)).t_type == TERRAINTYPE_EMPTY &&
-            getTerrainStruct(point(x,y+1)).t_type == TERRAINTYPE_EMPTY &&
+        if (getTerrainType(x,y) == TERRAINTYPE_EMPTY &&
+            getTerrainType(x,y+1) == TERRAINTYPE_EMPTY &&
             terrainTilesAdj(point(x,y),1,1,TERRAINTYPE_EMPTY,false) == 2)
         {
             setTerrainStruct(point(x,y),point(12.0,40.0),TERRAINTYPE_LADDER,16,0);
@@ -453,16 +468,16 @@ void terrain_map::trimEdges(int num_iters)
         for (int y = 0; y < (int)dim.y(); ++y)
         for (int x = 0; x < (int)dim.x(); ++x)
         {
-            if (getTerrainStruct(point(x,y)).t_type == TERRAINTYPE_WALL &&
+            if (getTerrainType(x,y) == TERRAINTYPE_WALL &&
                 terrainTilesAdj(point(x,y),1,1,TERRAINTYPE_EMPTY,true) == 3)
             {
-                terrain_vec[y][x].t_type = TERRAINTYPE_TRIMPLACEHOLDER;
+                cell_types[getCellIndex(x,y)] = (Uint8)TERRAINTYPE_TRIMPLACEHOLDER;
             }
         }
         for (int y = 0; y < (int)dim.y(); ++y)
         for (int x = 0; x < (int)dim.x(); ++x)
         {
-            if (getTerrainStruct(point(x,y)).t_type == TERRAINTYPE_TRIMPLACEHOLDER)
+            if (getTerrainType(x,y) == TERRAINTYPE_TRIMPLACEHOLDER)
             {
                 setTerrainStruct(point(x,y),point(0.0,0.0),TERRAINTYPE_EMPTY,0,0);
             }
@@ -480,11 +495,11 @@ void terrain_map::extendLadders()
         iter = 1.0;
         do
         {
-           if (!inRange(addPoints(ladder_points[i],point(0.0,iter)),point(0.0,0.0),point(dim.x()-1,dim.y()-1)))
+           if (!inRange(ladder_points[i] + point(0.0,iter),point(0.0,0.0),point(dim.x()-1,dim.y()-1)))
                bottom_end = true;
-           else if (getTerrainStruct(addPoints(ladder_points[i],point(0.0,iter))).t_type == TERRAINTYPE_EMPTY)
+           else if (getTerrainType(ladder_points[i].x(),ladder_points[i].y() + iter) == TERRAINTYPE_EMPTY)
            {
-               setTerrainStruct(addPoints(ladder_points[i],point(0.0,iter)),point(12.0,40.0),TERRAINTYPE_LADDER,16,0);
+               setTerrainStruct(ladder_points[i] + point(0.0,iter),point(12.0,40.0),TERRAINTYPE_LADDER,16,0);
                iter += 1.0;
            }
            else
@@ -493,11 +508,11 @@ void terrain_map::extendLadders()
         iter = -1.0;
         do
         {
-           if (!inRange(addPoints(ladder_points[i],point(0.0,iter)),point(0.0,0.0),point(dim.x()-1,dim.y()-1)))
+           if (!inRange(ladder_points[i] + point(0.0,iter),point(0.0,0.0),point(dim.x()-1,dim.y()-1)))
                top_end = true;
-           else if (getTerrainStruct(addPoints(ladder_points[i],point(0.0,iter))).t_type == TERRAINTYPE_EMPTY)
+           else if (getTerrainType(ladder_points[i].x(),ladder_points[i].y() + iter) == TERRAINTYPE_EMPTY)
            {
-               setTerrainStruct(addPoints(ladder_points[i],point(0.0,iter)),point(12.0,40.0),TERRAINTYPE_LADDER,16,0);
+               setTerrainStruct(ladder_points[i] + point(0.0,iter),point(12.0,40.0),TERRAINTYPE_LADDER,16,0);
                iter -= 1.0;
            }
            else
@@ -512,9 +527,9 @@ void terrain_map::trimUnneededLadders()
     for (int y = 2; y < (int)dim.y() - 2; ++y)
     for (int x = 1; x < (int)dim.x() - 1; ++x)
     {
-        if (getTerrainStruct(point(x,y)).t_type == TERRAINTYPE_LADDER &&
-            getTerrainStruct(point(x,y-2)).t_type == TERRAINTYPE_WALL &&
-            getTerrainStruct(point(x,y+2)).t_type == TERRAINTYPE_WALL)
+        if (getTerrainType(x,y) == TERRAINTYPE_LADDER &&
+            getTerrainType(x,y-2) == TERRAINTYPE_WALL &&
+            getTerrainType(x,y+2) == TERRAINTYPE_WALL)
         {
             setTerrainStruct(point(x,y),point(0.0,0.0),TERRAINTYPE_EMPTY,0,0);
             setTerrainStruct(point(x,y-1),point(0.0,0.0),TERRAINTYPE_EMPTY,0,0);
@@ -530,7 +545,7 @@ void terrain_map::addMiniPlatforms(int variation)
     for (int y = 1; y < (int)dim.y() - 1; ++y)
     for (int x = 1; x < (int)dim.x() - 1; ++x)
     {
-        if (getTerrainStruct(point(x,y)).t_type == TERRAINTYPE_EMPTY &&
+        if (getTerrainType(x,y) == TERRAINTYPE_EMPTY &&
             terrainTilesAdj(point(x,y),1,1+variation,TERRAINTYPE_EMPTY,false) == 8 + (6*variation))
         {
             setTerrainStruct(point(x,y),point(40.0,40.0),TERRAINTYPE_WALL,15,0);
@@ -539,11 +554,11 @@ void terrain_map::addMiniPlatforms(int variation)
     for (int y = 1; y < (int)dim.y() - 1; ++y)
     for (int x = 1; x < (int)dim.x() - 1; ++x)
     {
-        if (getTerrainStruct(point(x,y)).t_type == TERRAINTYPE_EMPTY &&
+        if (getTerrainType(x,y) == TERRAINTYPE_EMPTY &&
             terrainTilesAdj(point(x,y),1,1,TERRAINTYPE_WALL,true) == 2 &&
             terrainTilesAdj(point(x,y),1,1,TERRAINTYPE_WALL,false) == 2 &&
-            getTerrainStruct(point(x-1,y)).t_type == TERRAINTYPE_WALL &&
-            getTerrainStruct(point(x+1,y)).t_type == TERRAINTYPE_WALL)
+            getTerrainType(x-1,y) == TERRAINTYPE_WALL &&
+            getTerrainType(x+1,y) == TERRAINTYPE_WALL)
         {
             setTerrainStruct(point(x,y),point(40.0,40.0),TERRAINTYPE_WALL,15,0);
         }
@@ -555,11 +570,11 @@ void terrain_map::addMiniDoors()
     for (int y = 2; y < (int)dim.y() - 2; ++y)
     for (int x = 2; x < (int)dim.x() - 2; ++x)
     {
-        if (getTerrainStruct(point(x,y)).t_type == TERRAINTYPE_WALL &&
+        if (getTerrainType(x,y) == TERRAINTYPE_WALL &&
             terrainTilesAdj(point(x,y),1,1,TERRAINTYPE_WALL,true) == 2 &&
-            getTerrainStruct(point(x,y-1)).t_type == TERRAINTYPE_WALL &&
-            getTerrainStruct(point(x,y+1)).t_type == TERRAINTYPE_WALL &&
-            getTerrainStruct(point(x,y+2)).t_type != TERRAINTYPE_BIGDOOR &&
+            getTerrainType(x,y-1) == TERRAINTYPE_WALL &&
+            getTerrainType(x,y+1) == TERRAINTYPE_WALL &&
+            getTerrainType(x,y+2) != TERRAINTYPE_BIGDOOR &&
             terrainTilesAdj(point(x,y),2,7,TERRAINTYPE_DOOR,false) == 0)
         {
             setTerrainStruct(point(x,y),point(23.0,block_size.y()),TERRAINTYPE_DOOR,24,0);
@@ -572,13 +587,13 @@ void terrain_map::addBigDoors()
     for (int y = 2; y < (int)dim.y() - 2; ++y)
     for (int x = 2; x < (int)dim.x() - 2; ++x)
     {
-        if (getTerrainStruct(point(x,y)).t_type == TERRAINTYPE_WALL &&
+        if (getTerrainType(x,y) == TERRAINTYPE_WALL &&
             terrainTilesAdj(point(x,y),1,1,TERRAINTYPE_WALL,true) == 2 &&
             terrainTilesAdj(point(x,y+1),1,1,TERRAINTYPE_WALL,true) == 2 &&
-            getTerrainStruct(point(x,y-1)).t_type == TERRAINTYPE_WALL &&
-            getTerrainStruct(point(x,y-2)).t_type == TERRAINTYPE_WALL &&
-            getTerrainStruct(point(x,y+1)).t_type == TERRAINTYPE_WALL &&
-            getTerrainStruct(point(x,y+2)).t_type == TERRAINTYPE_WALL &&
+            getTerrainType(x,y-1) == TERRAINTYPE_WALL &&
+            getTerrainType(x,y-2) == TERRAINTYPE_WALL &&
+            getTerrainType(x,y+1) == TERRAINTYPE_WALL &&
+            getTerrainType(x,y+2) == TERRAINTYPE_WALL &&
             terrainTilesAdj(point(x,y),2,5,TERRAINTYPE_BIGDOOR,false) == 0)
         {
             setTerrainStruct(point(x,y+1),point(0.0,0.0),TERRAINTYPE_EMPTY,0,0);
@@ -594,7 +609,15 @@ point terrain_map::getBlockSize()
 
 terrain_struct terrain_map::getTerrainStruct(point p)
 {
-    return terrain_vec[p.y()][p.x()];
+    int i = getCellIndex(p.x(),p.y());
+    terrain_style &style = style_table[cell_styles[i]];
+    terrain_struct ts = {style.sze,(terrain_type)cell_types[i],style.tid,style.cid};
+    return ts;
+}
+
+terrain_type terrain_map::getTerrainType(int x, int y)
+{
+    return (terrain_type)cell_types[getCellIndex(x,y)];
 }
 
 point terrain_map::getDim()
@@ -603,15 +626,14 @@ point terrain_map::getDim()
 }
 
 int terrain_map::terrainTilesAdj(point p, int radx, int rady, terrain_type tt, bool vn) {
-    point aloc;
+    int px = (int)p.x();
+    int py = (int)p.y();
     int counter = 0;
-    for (int dy = -rady; dy <= rady; ++dy)
-    for (int dx = -radx; dx <= radx; ++dx) {
-        aloc.set(dx+p.x(),dy+p.y());
-        if (inRange(aloc,point(0.0,0.0),point(dim.x()-1.0,dim.y()-1.0)))
-        if (!isAt(aloc,p))
-        if (dx == 0 || dy == 0 || !vn)
-        if (terrain_vec[aloc.y()][aloc.x()].t_type == tt) {
+    for (int y = std::max(0,py - rady); y <= std::min((int)dim.y() - 1,py + rady); ++y)
+    for (int x = std::max(0,px - radx); x <= std::min((int)dim.x() - 1,px + radx); ++x) {
+        if (x != px || y != py)
+        if (x == px || y == py || !vn)
+        if (cell_types[getCellIndex(x,y)] == (Uint8)tt) {
             counter++;
         }
     }
@@ -633,8 +655,8 @@ void terrain_map::loadLayoutFromFile(std::string fileName) {
         }
     }
 
-    for (int x = 1; x < (int)dim.x() - 1; ++x)
-    for (int y = 1; y < (int)dim.y() - 1; ++y) {
+    for (int y = 1; y < (int)dim.y() - 1; ++y)
+    for (int x = 1; x < (int)dim.x() - 1; ++x) {
         p.set((double)x,(double)y);
 
         switch(layoutVector[((int)dim.x() * y) + x]) {
@@ -665,13 +687,13 @@ void terrain_map::loadLayoutFromFile(std::string fileName) {
 
     terrain_type l, r, u, d;
 
-    for (int x = 1; x < (int)dim.x() - 1; ++x) {
-        for (int y = 1; y < (int)dim.y() - 1; ++y) {
-            if (getTerrainStruct(point(x,y)).t_type == TERRAINTYPE_BRICKBACKDROP_1) {
-                l = getTerrainStruct(point(x-1,y)).t_type;
-                r = getTerrainStruct(point(x+1,y)).t_type;
-                u = getTerrainStruct(point(x,y-1)).t_type;
-                d = getTerrainStruct(point(x,y+1)).t_type;
+    for (int y = 1; y < (int)dim.y() - 1; ++y) {
+        for (int x = 1; x < (int)dim.x() - 1; ++x) {
+            if (getTerrainType(x,y) == TERRAINTYPE_BRICKBACKDROP_1) {
+                l = getTerrainType(x-1,y);
+                r = getTerrainType(x+1,y);
+                u = getTerrainType(x,y-1);
+                d = getTerrainType(x,y+1);
 
                 tid = 61;
 
@@ -690,7 +712,7 @@ void terrain_map::loadLayoutFromFile(std::string fileName) {
                 else if (u == TERRAINTYPE_WALL && d == TERRAINTYPE_BRICKBACKDROP_1)
                     tid = 63;
                 else if (d == TERRAINTYPE_WALL && u == TERRAINTYPE_BRICKBACKDROP_1) {
-                    if (getTerrainStruct(point(x+1,y-1)).t_type != TERRAINTYPE_WALL)
+                    if (getTerrainType(x+1,y-1) != TERRAINTYPE_WALL)
                         tid = 64;
                     else
                         tid = 72;
@@ -702,17 +724,20 @@ void terrain_map::loadLayoutFromFile(std::string fileName) {
                         tid = 71;
                 }
 
-                terrain_vec[y][x].tid = tid;
+                terrain_style style = style_table[cell_styles[getCellIndex(x,y)]];
+                cell_styles[getCellIndex(x,y)] = (Uint8)getStyleIndex(style.sze,tid,style.cid);
             }
         }
     }
 }
 
 void terrain_map::initGeneratorFields(point gridSize, point blockSize) {
-    terrain_struct terrainStruct = {point(0.0,0.0),TERRAINTYPE_WALL,15,0};
-    terrain_vec.resize( gridSize.y(), std::vector<terrain_struct>( gridSize.x(), terrainStruct ) );
     dim = gridSize;
     block_size = blockSize;
+    style_table.clear();
+    ladder_points.clear();
+    cell_types.assign((int)dim.x() * (int)dim.y(), (Uint8)TERRAINTYPE_WALL);
+    cell_styles.assign((int)dim.x() * (int)dim.y(), (Uint8)getStyleIndex(point(0.0,0.0),15,0));
 }
 
 point terrain_map::getStartBlock() {
@@ -4,7 +4,6 @@
 #ifndef GENERATE_H_
 #define GENERATE_H_
 
-#include <stack>
 #include "globals.h"
 #include "point.h"
 #include "rng.h"
@@ -60,6 +59,15 @@ struct terrain_struct
     int cid;
 };
 
+// size and texture of a terrain tile
+// (a map only uses a handful of these, so cells store an index into a table of them)
+struct terrain_style
+{
+    point sze;
+    int tid;
+    int cid;
+};
+
 class maze
 {
     public:
@@ -88,8 +96,11 @@ class maze
         maze_unit_type getUnit(point);
         point getMazeSize();
     private:
-        // maze array value designations:
-        std::vector < std::vector < maze_unit_type > > maze_array;
+        int getUnitIndex(int, int);
+        // one bit per unit (set -> MAZE_WALL), row by row
+        std::vector < bool > maze_walls;
+        // units to backtrack to while digging (kept between builds, like maze_walls)
+        std::vector < point > dig_stack;
         // start point from maze dig algorithm
         point start_dig;
         // end point from maze dig algorithm
@@ -124,13 +135,22 @@ public:
     void addExit(int);
     void addKeys(int);
     terrain_struct getTerrainStruct(point);
+    terrain_type getTerrainType(int,int);
     int terrainTilesAdj(point,int,int,terrain_type,bool);
     point getDim();
     point getBlockSize();
     point getStartBlock();
 private:
-    std::vector < std::vector < terrain_struct > > terrain_vec;
+    int getCellIndex(int,int);
+    int getStyleIndex(point,int,int);
+    // terrain_type of every cell, row by row
+    std::vector < Uint8 > cell_types;
+    // index into style_table of every cell, row by row
+    std::vector < Uint8 > cell_styles;
+    std::vector < terrain_style > style_table;
     std::vector < point > ladder_points;
+    // reused by every buildMaze call, so its storage is only allocated once
+    maze level_maze;
     point dim;
     point block_size;
     point startBlock;
@@ -15,6 +15,8 @@
 #include <sstream>
 #include <fstream>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
 
 #define uint unsigned int
 
@@ -49,6 +51,9 @@
 
 #define NUM_WEAPON_TYPES 8
 
+// most blood and gib props alive at once (the oldest ones get recycled)
+#define MAX_GIB_PROPS 512
+
 static const SDL_Color color_darkgray {50,50,50,0};
 static const SDL_Color color_white = {255,255,255,0};
 static const SDL_Color color_darkorange = {255,128,0,0};
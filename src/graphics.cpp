@@ -3,6 +3,21 @@
 
 #include "graphics.h"
 
+// sprite batches are drawn with SDL_RenderGeometry
+#if !SDL_VERSION_ATLEAST(2,0,18)
+#error "Pandemazium needs SDL 2.0.18 or newer (for SDL_RenderGeometry)"
+#endif
+
+/*
+ * File name of atlas image i (a sprite sheet or the font)
+ */
+static std::string getAtlasImageFileName(int i)
+{
+    if (i == FONT_ATLAS_IMAGE)
+        return FONT_FILE_NAME;
+    return texture_file_names[i];
+}
+
 /*
  * Set default values for SDL2 variables
  */
@@ -11,13 +26,44 @@ gfx_engine::gfx_engine()
     camera = point(0.0,0.0);
     screen = NULL;
     renderer = NULL;
-    font_texture = NULL;
-    for (int i = 0; i < NUM_TOTAL_TEXTURES; ++i)
+    static_chunk_columns = static_chunk_rows = 0;
+    num_sprites_drawn = num_sprites_culled = 0;
+    num_draw_calls = 0;
+    frame_number = 0;
+    batch_clear = submitted_clear = false;
+    render_thread = NULL;
+    render_mutex = NULL;
+    render_cond = NULL;
+    frame_submitted = render_thread_quit = false;
+    call_pending = call_result = false;
+    pending_call = NULL;
+    pending_call_data = NULL;
+    baking_chunk = NULL;
+    rendered_draw_calls = 0;
+    rendered_frame_ms = render_thread_ms = render_wait_ms = 0.0;
+    current_layer = SPRITELAYER_BACKDROP;
+    for (int i = 0; i < NUM_ATLAS_IMAGES; ++i)
     {
-        textures[i] = NULL;
+        sprites[i].texture = NULL;
+        sprites[i].area.x = sprites[i].area.y = sprites[i].area.w = sprites[i].area.h = 0;
+        image_jobs[i] = -1;
+        // a file listed twice is loaded once
+        first_image_use[i] = i;
+        for (int j = 0; j < i; ++j)
+        {
+            if (getAtlasImageFileName(j) == getAtlasImageFileName(i))
+            {
+                first_image_use[i] = j;
+                break;
+            }
+        }
     }
+    for (int i = 0; i < TEXT_RUN_CACHE_SIZE; ++i)
+        text_runs[i].glyphs.reserve(MAX_TEXT_RUN_LENGTH);
+    clearTextRuns();
 }
 
+
 /*
  * Free graphics memory 
  */
@@ -36,6 +82,14 @@ bool gfx_engine::initSDL()
     if(SDL_Init(SDL_INIT_EVERYTHING) == -1)
         return false;
 
+    // initialize the png loader here, before the asset loader's threads call IMG_Load
+    // (SDL_image would otherwise initialize it from each of them at once)
+    if((IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG) == 0)
+    {
+        std::cout << "Failed to initialize SDL_image\n";
+        return false;
+    }
+
     // initialize SDL_Window instance screen
     screen = SDL_CreateWindow("Pandemazium", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
                               (int)WINDOW_WIDTH, (int)WINDOW_HEIGHT, SDL_WINDOW_SHOWN );
@@ -43,57 +97,388 @@ bool gfx_engine::initSDL()
     if(screen == NULL)
         return false;
 
-    // initialize the renderer
+    // the renderer is created on the render thread, the only thread that uses it
+    startRenderThread();
+
+    if(!runOnRenderThread(&gfx_engine::createRenderer,NULL))
+        return false;
+
+    return true;
+}
+
+/*
+ * Render call: initialize the renderer (no data)
+ */
+bool gfx_engine::createRenderer(void *data)
+{
     renderer = SDL_CreateRenderer(screen, -1, SDL_RENDERER_ACCELERATED);
 
-    if(renderer == NULL)
+    return renderer != NULL;
+}
+
+/*
+ * Render call: destroy every texture and the renderer (no data)
+ */
+bool gfx_engine::destroyRenderer(void *data)
+{
+    freeStaticLayers();
+
+    for (int i = 0; i < (int)atlas_pages.size(); ++i)
+    {
+        SDL_DestroyTexture(atlas_pages[i]);
+        SDL_FreeSurface(atlas_page_images[i]);
+    }
+    atlas_pages.clear();
+    atlas_page_images.clear();
+
+    for (int i = 0; i < (int)early_textures.size(); ++i)
+    {
+        SDL_DestroyTexture(early_textures[i]);
+    }
+    early_textures.clear();
+    early_texture_images.clear();
+
+    if (renderer != NULL)
+    {
+        SDL_DestroyRenderer(renderer);
+        renderer = NULL;
+    }
+
+    return true;
+}
+
+/*
+ * Add a decoding job for the font and every entity texture
+ */
+void gfx_engine::queueTextureDecoding(asset_loader *loader)
+{
+    for (int i = 0; i < NUM_ATLAS_IMAGES; ++i)
+    {
+        if (first_image_use[i] == i)
+            image_jobs[i] = loader->addJob(ASSETTYPE_IMAGE,".\\Debug\\textures\\" + getAtlasImageFileName(i));
+        else
+            image_jobs[i] = image_jobs[first_image_use[i]];
+    }
+}
+
+/*
+ * Wait for image i to be decoded and upload it as a texture of its own, so that it
+ * can be drawn before the atlases are built (i.e. by the main menu)
+ */
+bool gfx_engine::loadEarlyTexture(asset_loader *loader, int i)
+{
+    loader->waitForJob(image_jobs[i]);
+
+    SDL_Surface *image = (SDL_Surface *)loader->getResult(image_jobs[i]);
+    if (image == NULL)
+    {
+        std::cout << "Failed to load " << getAtlasImageFileName(i) << "\n";
         return false;
+    }
 
-    font_texture = IMG_LoadTexture(renderer,".\\Debug\\textures\\mainfont16x16.png");
+    if (!runOnRenderThread(&gfx_engine::uploadEarlyTexture,image))
+        return false;
+    SDL_Texture *texture = early_textures.back();
 
-    if (font_texture == NULL)
+    for (int j = 0; j < NUM_ATLAS_IMAGES; ++j)
     {
-        std::cout << "Failed to load font file\n";
+        if (image_jobs[j] == image_jobs[i])
+        {
+            sprites[j].texture = texture;
+            sprites[j].area.x = sprites[j].area.y = 0;
+            sprites[j].area.w = image->w;
+            sprites[j].area.h = image->h;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Render call: upload an image (an SDL_Surface) as an early texture
+ */
+bool gfx_engine::uploadEarlyTexture(void *data)
+{
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer,(SDL_Surface *)data);
+    if (texture == NULL)
         return false;
+    SDL_SetTextureBlendMode(texture,SDL_BLENDMODE_BLEND);
+    early_textures.push_back(texture);
+    early_texture_images.push_back((SDL_Surface *)data);
+
+    return true;
+}
+
+/*
+ * Build the atlases once every image is decoded (call waitForAll first), and
+ * replace the early textures with their place in the atlases
+ */
+bool gfx_engine::buildTextureAtlases(asset_loader *loader)
+{
+    SDL_Surface *images[NUM_ATLAS_IMAGES];
+    bool loaded = true;
+
+    for (int i = 0; i < NUM_ATLAS_IMAGES; ++i)
+    {
+        images[i] = NULL;
+        if (first_image_use[i] != i)
+            continue;
+        images[i] = (SDL_Surface *)loader->takeResult(image_jobs[i]);
+        if (images[i] == NULL)
+        {
+            std::cout << "Failed to load " << getAtlasImageFileName(i) << "\n";
+            loaded = false;
+        }
     }
-    // initialize all entity textures
-    for (int i = 0; i < NUM_TOTAL_TEXTURES; ++i)
+
+    return finishTextureAtlases(images,loaded);
+}
+
+/*
+ * Build the atlases straight from the pixels in an asset bundle (nothing is
+ * decoded). Returns false if the bundle lacks an image.
+ */
+bool gfx_engine::loadTexturesFromBundle(asset_bundle *bundle)
+{
+    SDL_Surface *images[NUM_ATLAS_IMAGES];
+    bool loaded = true;
+
+    for (int i = 0; i < NUM_ATLAS_IMAGES; ++i)
     {
-        textures[i] = IMG_LoadTexture(renderer,&(".\\Debug\\textures\\" + texture_file_names[i])[0]);
-        if (textures[i] == NULL)
+        images[i] = NULL;
+        if (!loaded || first_image_use[i] != i)
+            continue;
+        const bundle_entry *entry = bundle->findEntry(getAtlasImageFileName(i),BUNDLEENTRY_IMAGE);
+        // the surface uses the mapped pixels (SDL_FreeSurface leaves them alone)
+        if (entry != NULL)
+            images[i] = SDL_CreateRGBSurfaceWithFormatFrom((void *)bundle->getEntryData(entry),(int)entry->width,(int)entry->height,
+                                                           32,(int)entry->width * 4,SDL_PIXELFORMAT_RGBA32);
+        if (images[i] == NULL)
         {
-            std::cout << "Failed to load " + texture_file_names[i][0] << "\n";
-            return false;
+            std::cout << getAtlasImageFileName(i) << " is not in the asset bundle\n";
+            loaded = false;
         }
     }
+
+    return finishTextureAtlases(images,loaded);
+}
+
+/*
+ * Pack images into the atlases (if loaded, i.e. every image is there) and free them.
+ * On success every handle points into the atlases and the early textures are gone.
+ */
+bool gfx_engine::finishTextureAtlases(SDL_Surface **images, bool loaded)
+{
+    if (loaded)
+        loaded = runOnRenderThread(&gfx_engine::uploadTextureAtlases,images);
+
+    for (int i = 0; i < NUM_ATLAS_IMAGES; ++i)
+    {
+        if (images[i] != NULL)
+            SDL_FreeSurface(images[i]);
+        if (loaded)
+            sprites[i] = sprites[first_image_use[i]];
+    }
+
+    // cached glyphs still point into the early font texture, which is gone now
+    if (loaded)
+        clearTextRuns();
+
+    return loaded;
+}
+
+/*
+ * Render call: pack the images (an array of NUM_ATLAS_IMAGES surfaces) into the
+ * atlases, and destroy the early textures once they are no longer needed
+ */
+bool gfx_engine::uploadTextureAtlases(void *data)
+{
+    // the images are freed after this call (even if it fails), so the early
+    // textures can't be uploaded again from here on
+    early_texture_images.clear();
+
+    if (!buildTextureAtlases((SDL_Surface **)data))
+        return false;
+
+    for (int i = 0; i < (int)early_textures.size(); ++i)
+        SDL_DestroyTexture(early_textures[i]);
+    early_textures.clear();
+
     return true;
 }
 
+/*
+ * Create every atlas page and early texture again from their pixels, after a
+ * device reset lost them (cached text runs are dropped, as their glyphs point
+ * at the old textures)
+ */
+void gfx_engine::reloadTextures()
+{
+    if (!runOnRenderThread(&gfx_engine::reuploadTextures,NULL))
+        std::cout << "Failed to reload textures after a device reset\n";
+
+    clearTextRuns();
+}
 
 /*
- * free/destroy graphics ptr objects
+ * Render call: upload the atlas pages and early textures again (no data)
  */
-void gfx_engine::freeSDL()
+bool gfx_engine::reuploadTextures(void *data)
 {
-    for (int i = 0; i < NUM_TOTAL_TEXTURES; ++i)
+    bool uploaded = true;
+
+    for (int i = 0; i < (int)atlas_pages.size(); ++i)
+        uploaded = reuploadTexture(&atlas_pages[i],atlas_page_images[i]) && uploaded;
+
+    for (int i = 0; i < (int)early_texture_images.size(); ++i)
+        uploaded = reuploadTexture(&early_textures[i],early_texture_images[i]) && uploaded;
+
+    return uploaded;
+}
+
+/*
+ * Replace *texture with a new texture of image, and point the handles that used
+ * the old one at it. The old texture is kept if the new one can't be created.
+ */
+bool gfx_engine::reuploadTexture(SDL_Texture **texture, SDL_Surface *image)
+{
+    SDL_Texture *new_texture = SDL_CreateTextureFromSurface(renderer,image);
+    if (new_texture == NULL)
+        return false;
+    SDL_SetTextureBlendMode(new_texture,SDL_BLENDMODE_BLEND);
+
+    for (int i = 0; i < NUM_ATLAS_IMAGES; ++i)
     {
-        if (textures[i] != NULL)
+        if (sprites[i].texture == *texture)
+            sprites[i].texture = new_texture;
+    }
+
+    SDL_DestroyTexture(*texture);
+    *texture = new_texture;
+
+    return true;
+}
+
+/*
+ * Pack images (NULL entries are skipped) into as few atlas pages as possible,
+ * shelf by shelf, tallest image first. Sets the handle of every image packed.
+ */
+bool gfx_engine::buildTextureAtlases(SDL_Surface **images)
+{
+    int atlas_dim = MAX_ATLAS_DIM;
+    SDL_RendererInfo info;
+
+    if (SDL_GetRendererInfo(renderer,&info) == 0 && info.max_texture_width > 0 && info.max_texture_height > 0)
+        atlas_dim = std::min(atlas_dim,std::min(info.max_texture_width,info.max_texture_height));
+
+    // (height, image) pairs, tallest first
+    std::vector< std::pair<int,int> > order;
+    for (int i = 0; i < NUM_ATLAS_IMAGES; ++i)
+    {
+        if (images[i] != NULL)
+            order.push_back(std::make_pair(images[i]->h,i));
+    }
+    std::sort(order.rbegin(),order.rend());
+
+    int page_of[NUM_ATLAS_IMAGES];
+    std::vector<int> page_width;
+    std::vector<int> page_height;
+    int shelf_x = 0;
+    int shelf_y = 0;
+    int shelf_height = 0;
+
+    for (int k = 0; k < (int)order.size(); ++k)
+    {
+        int i = order[k].second;
+        int w = images[i]->w + ATLAS_PADDING * 2;
+        int h = images[i]->h + ATLAS_PADDING * 2;
+
+        if (w > atlas_dim || h > atlas_dim)
+        {
+            std::cout << getAtlasImageFileName(i) << " does not fit in a texture atlas\n";
+            return false;
+        }
+
+        // start a new shelf when this one is full, and a new page when the shelves are
+        if (!page_width.empty() && shelf_x + w > atlas_dim)
+        {
+            shelf_y += shelf_height;
+            shelf_x = shelf_height = 0;
+        }
+        if (page_width.empty() || shelf_y + h > atlas_dim)
         {
-            SDL_DestroyTexture(textures[i]);
-            textures[i] = NULL;
+            page_width.push_back(0);
+            page_height.push_back(0);
+            shelf_x = shelf_y = shelf_height = 0;
         }
+
+        sprites[i].area.x = shelf_x + ATLAS_PADDING;
+        sprites[i].area.y = shelf_y + ATLAS_PADDING;
+        sprites[i].area.w = images[i]->w;
+        sprites[i].area.h = images[i]->h;
+        page_of[i] = (int)page_width.size() - 1;
+
+        shelf_x += w;
+        shelf_height = std::max(shelf_height,h);
+        page_width.back() = std::max(page_width.back(),shelf_x);
+        page_height.back() = std::max(page_height.back(),shelf_y + shelf_height);
     }
 
-    if (font_texture != NULL)
+    for (int p = 0; p < (int)page_width.size(); ++p)
     {
-        SDL_DestroyTexture(font_texture);
-        font_texture = NULL;
+        // a new surface is all transparent pixels
+        SDL_Surface *page = SDL_CreateRGBSurfaceWithFormat(0,page_width[p],page_height[p],32,SDL_PIXELFORMAT_RGBA32);
+        if (page == NULL)
+        {
+            std::cout << "Failed to create texture atlas\n";
+            return false;
+        }
+
+        for (int k = 0; k < (int)order.size(); ++k)
+        {
+            int i = order[k].second;
+            if (page_of[i] != p)
+                continue;
+            // copy the pixels as they are (alpha included)
+            SDL_Rect dest = sprites[i].area;
+            SDL_SetSurfaceBlendMode(images[i],SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(images[i],NULL,page,&dest);
+        }
+
+        SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer,page);
+        if (texture == NULL)
+        {
+            SDL_FreeSurface(page);
+            std::cout << "Failed to create texture atlas\n";
+            return false;
+        }
+        SDL_SetTextureBlendMode(texture,SDL_BLENDMODE_BLEND);
+        atlas_pages.push_back(texture);
+        atlas_page_images.push_back(page);
+
+        for (int k = 0; k < (int)order.size(); ++k)
+        {
+            if (page_of[order[k].second] == p)
+                sprites[order[k].second].texture = texture;
+        }
     }
 
-    if (renderer != NULL)
+    return true;
+}
+
+
+/*
+ * free/destroy graphics ptr objects
+ */
+void gfx_engine::freeSDL()
+{
+    // after the frame it was given, the render thread destroys what it created
+    runOnRenderThread(&gfx_engine::destroyRenderer,NULL);
+    stopRenderThread();
+
+    for (int i = 0; i < NUM_ATLAS_IMAGES; ++i)
     {
-        SDL_DestroyRenderer(renderer);
-        renderer = NULL;
+        sprites[i].texture = NULL;
     }
 
     if (screen != NULL)
@@ -102,14 +487,16 @@ void gfx_engine::freeSDL()
         screen = NULL;
     }
 
+    IMG_Quit();
     SDL_Quit();
 }
 
 /*
- * Render given subarea (row, frame, textureArea) of texture object in memory and place it at a specific
+ * Render given subarea (row, frame, textureArea) of sprite sheet in memory and place it at a specific
  * location (loc) on the window. Place it on the screen taking up a specific area on the window (possible stretched)
+ * The sprite is added to the batch of the current layer (see updateScreen).
  */
-void gfx_engine::renderSprite(SDL_Texture *texture, point loc, point textureArea, point area, int frame, int row, SDL_RendererFlip orientation, bool parallax, SDL_Color col_multval, int scale)
+void gfx_engine::renderSprite(sprite_handle sprite, point loc, point textureArea, point area, int frame, int row, SDL_RendererFlip orientation, bool parallax, SDL_Color col_multval, int scale)
 {
     SDL_Rect rect;
     SDL_Rect crop;
@@ -119,6 +506,14 @@ void gfx_engine::renderSprite(SDL_Texture *texture, point loc, point textureArea
     crop.w = (int)textureArea.x();
     crop.h = (int)textureArea.y();
 
+    // the crop can't reach past the sheet (into its neighbours in the atlas), just as it
+    // couldn't reach past the edges of a texture of its own
+    SDL_Rect sheet = {0,0,sprite.area.w,sprite.area.h};
+    if (!SDL_IntersectRect(&crop,&sheet,&crop))
+        return;
+    crop.x += sprite.area.x;
+    crop.y += sprite.area.y;
+
     rect.x = (int)loc.x() * 2;
     rect.y = (int)loc.y() * 2;
     rect.w = (int)area.x() * scale;
@@ -130,15 +525,286 @@ void gfx_engine::renderSprite(SDL_Texture *texture, point loc, point textureArea
         rect.y -= camera.y();
     }
 
-    // don't render anything not on screen (optimize)
-    // if (rect.x + rect.w < 0 || rect.y + rect.h < 0 ||
-    //    (double)rect.x > MAP_WIDTH - ((double)WINDOW_WIDTH/scale) || (double)rect.y > MAP_HEIGHT - ((double)WINDOW_HEIGHT/scale))
-    //     return;
+    // don't render anything not on screen (before any texture state is changed)
+    if (!isOnScreen(rect))
+    {
+        num_sprites_culled++;
+        return;
+    }
+    num_sprites_drawn++;
+
+    // black means no tint
+    SDL_Color color = {255,255,255,255};
     if (col_multval.r != 0 || col_multval.g != 0 || col_multval.b != 0)
-        SDL_SetTextureColorMod(texture,col_multval.r, col_multval.g, col_multval.b);
+    {
+        color.r = col_multval.r;
+        color.g = col_multval.g;
+        color.b = col_multval.b;
+    }
+
+    addQuad(sprite.texture,crop,rect,color,orientation);
+}
+
+void gfx_engine::addQuad(SDL_Texture *texture, SDL_Rect crop, SDL_Rect rect, SDL_Color color, SDL_RendererFlip orientation)
+{
+    sprite_quad quad;
+    quad.layer = current_layer;
+    quad.texture = texture;
+    quad.crop = crop;
+    quad.rect = rect;
+    quad.color = color;
+    quad.orientation = orientation;
+    sprite_batch.push_back(quad);
+}
+
+/*
+ * Layer of every sprite, character and rectangle drawn from now on
+ */
+void gfx_engine::setSpriteLayer(sprite_layer layer)
+{
+    current_layer = layer;
+}
+
+/*
+ * Batch order: by layer, then by texture (filled rectangles go on top of the
+ * sprites of their layer). Quads that compare equal keep the order they were added in.
+ */
+static bool isQuadDrawnBefore(const sprite_quad &a, const sprite_quad &b)
+{
+    if (a.layer != b.layer)
+        return a.layer < b.layer;
+    if ((a.texture == NULL) != (b.texture == NULL))
+        return b.texture == NULL;
+    return a.texture < b.texture;
+}
+
+static SDL_Vertex makeVertex(int x, int y, SDL_Color color, float u, float v)
+{
+    SDL_Vertex vertex;
+    vertex.position.x = (float)x;
+    vertex.position.y = (float)y;
+    vertex.color = color;
+    vertex.tex_coord.x = u;
+    vertex.tex_coord.y = v;
+    return vertex;
+}
+
+/*
+ * Draw every quad of a draw list, one SDL_RenderGeometry call per run of quads sharing
+ * a texture, and empty the list. Returns the number of calls.
+ */
+int gfx_engine::drawSpriteList(std::vector<sprite_quad> *quads)
+{
+    int draw_calls = 0;
+
+    if (renderer == NULL)
+    {
+        quads->clear();
+        return draw_calls;
+    }
+
+    std::stable_sort(quads->begin(),quads->end(),isQuadDrawnBefore);
+
+    int run_start = 0;
+    while (run_start < (int)quads->size())
+    {
+        SDL_Texture *texture = (*quads)[run_start].texture;
+        int texture_width = 1;
+        int texture_height = 1;
+        if (texture != NULL)
+            SDL_QueryTexture(texture,NULL,NULL,&texture_width,&texture_height);
+
+        batch_vertices.clear();
+        batch_indices.clear();
+
+        int run_end = run_start;
+        for (; run_end < (int)quads->size() && (*quads)[run_end].texture == texture; ++run_end)
+        {
+            sprite_quad *quad = &(*quads)[run_end];
+            float u0 = (float)quad->crop.x / (float)texture_width;
+            float v0 = (float)quad->crop.y / (float)texture_height;
+            float u1 = (float)(quad->crop.x + quad->crop.w) / (float)texture_width;
+            float v1 = (float)(quad->crop.y + quad->crop.h) / (float)texture_height;
+            if (quad->orientation & SDL_FLIP_HORIZONTAL)
+                std::swap(u0,u1);
+            if (quad->orientation & SDL_FLIP_VERTICAL)
+                std::swap(v0,v1);
+
+            int first = (int)batch_vertices.size();
+            int x1 = quad->rect.x + quad->rect.w;
+            int y1 = quad->rect.y + quad->rect.h;
+            batch_vertices.push_back(makeVertex(quad->rect.x,quad->rect.y,quad->color,u0,v0));
+            batch_vertices.push_back(makeVertex(x1,quad->rect.y,quad->color,u1,v0));
+            batch_vertices.push_back(makeVertex(x1,y1,quad->color,u1,v1));
+            batch_vertices.push_back(makeVertex(quad->rect.x,y1,quad->color,u0,v1));
+            batch_indices.push_back(first);
+            batch_indices.push_back(first + 1);
+            batch_indices.push_back(first + 2);
+            batch_indices.push_back(first);
+            batch_indices.push_back(first + 2);
+            batch_indices.push_back(first + 3);
+        }
+
+        SDL_RenderGeometry(renderer,texture,&batch_vertices[0],(int)batch_vertices.size(),&batch_indices[0],(int)batch_indices.size());
+        draw_calls++;
+        run_start = run_end;
+    }
+
+    quads->clear();
+    return draw_calls;
+}
+
+int gfx_engine::getNumDrawCalls()
+{
+    return num_draw_calls;
+}
+
+double gfx_engine::getRenderWaitTime()
+{
+    return render_wait_ms;
+}
+
+double gfx_engine::getRenderThreadTime()
+{
+    return render_thread_ms;
+}
+
+static int SDLCALL renderThreadMain(void *data)
+{
+    ((gfx_engine *)data)->runRenderThread();
+    return 0;
+}
+
+/*
+ * Start the render thread. If it can't be started, updateScreen draws and presents
+ * every frame itself.
+ */
+void gfx_engine::startRenderThread()
+{
+    render_mutex = SDL_CreateMutex();
+    render_cond = SDL_CreateCond();
+    frame_submitted = render_thread_quit = call_pending = false;
+
+    if (render_mutex != NULL && render_cond != NULL)
+        render_thread = SDL_CreateThread(renderThreadMain,"render",this);
+
+    if (render_thread == NULL)
+    {
+        std::cout << "Failed to start render thread\n";
+        stopRenderThread();
+    }
+}
+
+/*
+ * Let the render thread present the frame it was given, and wait for it to end
+ */
+void gfx_engine::stopRenderThread()
+{
+    if (render_thread != NULL)
+    {
+        SDL_LockMutex(render_mutex);
+        render_thread_quit = true;
+        SDL_CondBroadcast(render_cond);
+        SDL_UnlockMutex(render_mutex);
+        SDL_WaitThread(render_thread,NULL);
+        render_thread = NULL;
+    }
+    if (render_cond != NULL)
+    {
+        SDL_DestroyCond(render_cond);
+        render_cond = NULL;
+    }
+    if (render_mutex != NULL)
+    {
+        SDL_DestroyMutex(render_mutex);
+        render_mutex = NULL;
+    }
+}
+
+/*
+ * Wait until the render thread has presented the submitted frame
+ */
+void gfx_engine::waitForRenderThread()
+{
+    if (render_thread == NULL)
+        return;
+
+    SDL_LockMutex(render_mutex);
+    while (frame_submitted)
+        SDL_CondWait(render_cond,render_mutex);
+    num_draw_calls = rendered_draw_calls;
+    render_thread_ms = rendered_frame_ms;
+    SDL_UnlockMutex(render_mutex);
+}
+
+/*
+ * Run a render call on the render thread (after the frame it was given, if any) and
+ * wait for its result. Without a render thread the call is run on this thread.
+ */
+bool gfx_engine::runOnRenderThread(render_call call, void *data)
+{
+    if (render_thread == NULL)
+        return (this->*call)(data);
+
+    SDL_LockMutex(render_mutex);
+    pending_call = call;
+    pending_call_data = data;
+    call_pending = true;
+    SDL_CondBroadcast(render_cond);
+    while (call_pending)
+        SDL_CondWait(render_cond,render_mutex);
+    bool result = call_result;
+    SDL_UnlockMutex(render_mutex);
+
+    return result;
+}
+
+/*
+ * Render thread: draw and present each submitted frame and run each render call,
+ * until stopRenderThread
+ */
+void gfx_engine::runRenderThread()
+{
+    SDL_LockMutex(render_mutex);
+    while (true)
+    {
+        while (!frame_submitted && !call_pending && !render_thread_quit)
+            SDL_CondWait(render_cond,render_mutex);
+
+        if (frame_submitted)
+        {
+            SDL_UnlockMutex(render_mutex);
+
+            Uint64 start_counter = SDL_GetPerformanceCounter();
+            if (submitted_clear)
+                SDL_RenderClear(renderer);
+            int draw_calls = drawSpriteList(&submitted_batch);
+            SDL_RenderPresent(renderer);
+            double ms = (double)(SDL_GetPerformanceCounter() - start_counter) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+            SDL_LockMutex(render_mutex);
+            rendered_draw_calls = draw_calls;
+            rendered_frame_ms = ms;
+            frame_submitted = false;
+            SDL_CondBroadcast(render_cond);
+        }
+        else if (call_pending)
+        {
+            render_call call = pending_call;
+            void *data = pending_call_data;
+            SDL_UnlockMutex(render_mutex);
+
+            bool result = (this->*call)(data);
 
-    SDL_RenderCopyEx(renderer,texture,&crop,&rect,0.0,NULL,orientation);
-    SDL_SetTextureColorMod(texture,255,255,255);
+            SDL_LockMutex(render_mutex);
+            call_result = result;
+            call_pending = false;
+            SDL_CondBroadcast(render_cond);
+        }
+        else
+            break;
+    }
+    SDL_UnlockMutex(render_mutex);
 }
 
 /*
@@ -147,12 +813,80 @@ void gfx_engine::renderSprite(SDL_Texture *texture, point loc, point textureArea
  */
 void gfx_engine::addBitmapString(SDL_Color col, std::string string_val, point loc)
 {
+    addBitmapString(col,string_val.c_str(),loc);
+}
+
+void gfx_engine::addBitmapString(SDL_Color col, const char *string_val, point loc)
+{
+    int length = (int)strlen(string_val);
+
+    if (length == 0)
+        return;
+
+    if (length > MAX_TEXT_RUN_LENGTH)
+    {
+        for (int i = 0; i < length; ++i)
+            addBitmapCharacter(col, (int)string_val[i], point(loc.x()+(i*FONT_CHAR_WIDTH),loc.y()));
+        return;
+    }
+
+    text_run *run = getTextRun(col,string_val,loc);
+
+    for (int i = 0; i < (int)run->glyphs.size(); ++i)
+    {
+        sprite_batch.push_back(run->glyphs[i]);
+        sprite_batch.back().layer = current_layer;
+    }
+}
+
+/*
+ * Cached glyph quads of string_val drawn at loc with color col. If they
+ * aren't cached, they replace the least recently used text run.
+ */
+text_run *gfx_engine::getTextRun(SDL_Color col, const char *string_val, point loc)
+{
+    text_run *oldest = &text_runs[0];
+
+    for (int i = 0; i < TEXT_RUN_CACHE_SIZE; ++i)
+    {
+        text_run *run = &text_runs[i];
+        if (run->loc == loc && run->color.r == col.r && run->color.g == col.g && run->color.b == col.b &&
+            strcmp(run->text,string_val) == 0)
+        {
+            run->last_used = frame_number;
+            return run;
+        }
+        if (run->last_used < oldest->last_used)
+            oldest = run;
+    }
+
+    strcpy(oldest->text,string_val);
+    oldest->color = col;
+    oldest->loc = loc;
+    oldest->last_used = frame_number;
+    oldest->glyphs.clear();
+
     int ascii_val = 0;
-    for (int i = 0; i < (int)string_val.size(); ++i)
+    for (int i = 0; string_val[i] != '\0'; ++i)
     {
         ascii_val = (int)string_val[i];
         if (ascii_val >= 0 && ascii_val <= 255)
-            addBitmapCharacter(col, ascii_val, point(loc.x()+(i*FONT_CHAR_WIDTH),loc.y()));
+            oldest->glyphs.push_back(makeGlyphQuad(col, ascii_val, point(loc.x()+(i*FONT_CHAR_WIDTH),loc.y())));
+    }
+
+    return oldest;
+}
+
+/*
+ * Forget every cached text run (when the font moves to another texture)
+ */
+void gfx_engine::clearTextRuns()
+{
+    for (int i = 0; i < TEXT_RUN_CACHE_SIZE; ++i)
+    {
+        text_runs[i].text[0] = '\0';
+        text_runs[i].last_used = -1;
+        text_runs[i].glyphs.clear();
     }
 }
 
@@ -161,40 +895,85 @@ void gfx_engine::addBitmapString(SDL_Color col, std::string string_val, point lo
  */
 void gfx_engine::addBitmapCharacter(SDL_Color col, int ascii_val, point loc)
 {
-    SDL_Rect rect;
-    SDL_Rect crop;
+    if (ascii_val >= 0 && ascii_val <= 255)
+        sprite_batch.push_back(makeGlyphQuad(col, ascii_val, loc));
+}
 
-    // crop out bitmap tile given ascii_val, TILEWID, and TILEHGT
-    crop.x = (ascii_val % FONT_COLUMNS) * FONT_CHAR_WIDTH;
-    crop.y = (int)(ascii_val / FONT_ROWS) * FONT_CHAR_HEIGHT;
-    crop.w = FONT_CHAR_WIDTH;
-    crop.h = FONT_CHAR_HEIGHT;
+sprite_quad gfx_engine::makeGlyphQuad(SDL_Color col, int ascii_val, point loc)
+{
+    sprite_quad glyph;
+    sprite_handle font = sprites[FONT_ATLAS_IMAGE];
 
-    rect.x = (int)loc.x();
-    rect.y = (int)loc.y();
-    rect.w = FONT_CHAR_WIDTH;
-    rect.h = FONT_CHAR_HEIGHT;
+    // crop out bitmap tile given ascii_val, TILEWID, and TILEHGT
+    glyph.crop.x = font.area.x + (ascii_val % FONT_COLUMNS) * FONT_CHAR_WIDTH;
+    glyph.crop.y = font.area.y + (int)(ascii_val / FONT_ROWS) * FONT_CHAR_HEIGHT;
+    glyph.crop.w = FONT_CHAR_WIDTH;
+    glyph.crop.h = FONT_CHAR_HEIGHT;
 
-    //Render foreground character to screen (via parsing the bitmap font)
+    glyph.rect.x = (int)loc.x();
+    glyph.rect.y = (int)loc.y();
+    glyph.rect.w = FONT_CHAR_WIDTH;
+    glyph.rect.h = FONT_CHAR_HEIGHT;
 
-    SDL_SetTextureColorMod(font_texture,col.r,col.g,col.b);
+    glyph.layer = current_layer;
+    glyph.texture = font.texture;
+    glyph.color.r = col.r;
+    glyph.color.g = col.g;
+    glyph.color.b = col.b;
+    glyph.color.a = 255;
+    glyph.orientation = SDL_FLIP_NONE;
 
-    SDL_RenderCopy(renderer,font_texture,&crop,&rect);
+    return glyph;
 }
 
 void gfx_engine::drawRectangle(SDL_Color c, point loc, point area)
 {
     SDL_Rect rect = {(int)loc.x()*2 - (int)camera.x(),(int)loc.y()*2 - (int)camera.y(),(int)area.x()*2,(int)area.y()*2};
-    SDL_SetRenderDrawColor(renderer,c.r,c.g,c.b,0);
-    SDL_RenderFillRect(renderer,&rect);
+    if (!isOnScreen(rect))
+        return;
+    SDL_Color color = {c.r,c.g,c.b,255};
+    addQuad(NULL,rect,rect,color,SDL_FLIP_NONE);
+}
+
+/*
+ * Does rect (in window pixels) overlap the window?
+ * (the current static layer chunk when baking, which is smaller than the window)
+ */
+bool gfx_engine::isOnScreen(SDL_Rect rect)
+{
+    return rect.x < (int)WINDOW_WIDTH && rect.y < (int)WINDOW_HEIGHT &&
+           rect.x + rect.w > 0 && rect.y + rect.h > 0;
 }
 
 /*
- * Clear sceen to black
+ * Sprites skipped before reaching renderSprite (i.e. by a spatial query)
+ */
+void gfx_engine::countCulledSprites(int n)
+{
+    num_sprites_culled += n;
+}
+
+int gfx_engine::getNumSpritesDrawn()
+{
+    return num_sprites_drawn;
+}
+
+int gfx_engine::getNumSpritesCulled()
+{
+    return num_sprites_culled;
+}
+
+/*
+ * Clear sceen to black when the frame is drawn (and start counting drawn and culled
+ * sprites for a new frame, starting with the backdrop layer)
  */
 void gfx_engine::clearScreen()
 {
-    SDL_RenderClear(renderer);
+    num_sprites_drawn = num_sprites_culled = 0;
+    frame_number++;
+    current_layer = SPRITELAYER_BACKDROP;
+    sprite_batch.clear();
+    batch_clear = true;
 }
 
 /*
@@ -202,7 +981,7 @@ void gfx_engine::clearScreen()
  */
 void gfx_engine::updateCamera(point center, point current_level_size)
 {
-    camera = addPoints(center,point(-1.0*(double)WINDOW_WIDTH/(4.0),-1.0*(double)WINDOW_HEIGHT/(4.0)));
+    camera = center + point(-1.0*(double)WINDOW_WIDTH/(4.0),-1.0*(double)WINDOW_HEIGHT/(4.0));
 
     if(camera.x() < 0.0)
        camera.setx(0.0);
@@ -213,7 +992,7 @@ void gfx_engine::updateCamera(point center, point current_level_size)
     if(camera.y() > MAP_HEIGHT - ((double)WINDOW_HEIGHT/2.0))
        camera.sety(MAP_HEIGHT - ((double)WINDOW_HEIGHT/2.0));
 
-    camera = multPoints(camera, point(2.0,2.0));
+    camera = camera * point(2.0,2.0);
 }
 
 /*
@@ -225,17 +1004,220 @@ point gfx_engine::getCamera()
 }
 
 /*
- * Update display
+ * Hand the recorded frame to the render thread (once it is done with the previous
+ * one), which draws it and updates display while the next frame is simulated
  */
 void gfx_engine::updateScreen()
 {
-    SDL_RenderPresent(renderer);
+    Uint64 start_counter = SDL_GetPerformanceCounter();
+
+    if (render_thread == NULL)
+    {
+        if (batch_clear)
+            SDL_RenderClear(renderer);
+        num_draw_calls = drawSpriteList(&sprite_batch);
+        SDL_RenderPresent(renderer);
+    }
+    else
+    {
+        waitForRenderThread();
+        SDL_LockMutex(render_mutex);
+        std::swap(sprite_batch,submitted_batch);
+        submitted_clear = batch_clear;
+        frame_submitted = true;
+        SDL_CondBroadcast(render_cond);
+        SDL_UnlockMutex(render_mutex);
+        sprite_batch.clear();
+    }
+
+    batch_clear = false;
+    render_wait_ms = (double)(SDL_GetPerformanceCounter() - start_counter) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+/*
+ * Get the atlas handle of a texture file from the list of texture files
+ */
+sprite_handle gfx_engine::getTexture(int i)
+{
+    return sprites[i];
+}
+
+/*
+ * Create the static layer chunks covering a level of size level_size (kept if the
+ * level needs as many chunks as the previous one). Returns false if the renderer
+ * can not render to textures, in which case the static geometry has to be drawn
+ * sprite by sprite.
+ */
+bool gfx_engine::initStaticLayers(point level_size)
+{
+    if (renderer == NULL)
+        return false;
+
+    return runOnRenderThread(&gfx_engine::createStaticLayers,&level_size);
+}
+
+/*
+ * Render call: create the chunks for a level of the size (a point) given
+ */
+bool gfx_engine::createStaticLayers(void *data)
+{
+    point level_size = *(point *)data;
+
+    if (!SDL_RenderTargetSupported(renderer))
+        return false;
+
+    int columns = std::max(1,(int)std::ceil(level_size.x() * 2.0 / (double)STATIC_CHUNK_DIM));
+    int rows = std::max(1,(int)std::ceil(level_size.y() * 2.0 / (double)STATIC_CHUNK_DIM));
+
+    if (columns == static_chunk_columns && rows == static_chunk_rows)
+        return true;
+
+    freeStaticLayers();
+
+    for (int l = 0; l < NUM_STATIC_LAYERS; ++l)
+    for (int i = 0; i < columns * rows; ++i)
+    {
+        SDL_Texture *chunk = SDL_CreateTexture(renderer,SDL_PIXELFORMAT_RGBA8888,SDL_TEXTUREACCESS_TARGET,STATIC_CHUNK_DIM,STATIC_CHUNK_DIM);
+        if (chunk == NULL)
+        {
+            freeStaticLayers();
+            return false;
+        }
+        SDL_SetTextureBlendMode(chunk,SDL_BLENDMODE_BLEND);
+        static_chunks[l].push_back(chunk);
+    }
+
+    static_chunk_columns = columns;
+    static_chunk_rows = rows;
+    return true;
+}
+
+/*
+ * Destroy the chunks, so that the next initStaticLayers creates new ones
+ * (after a device reset the old ones can't be drawn into)
+ */
+void gfx_engine::discardStaticLayers()
+{
+    runOnRenderThread(&gfx_engine::destroyStaticLayers,NULL);
 }
 
 /*
- * Get texture object from list of texture files
+ * Render call: destroy the chunks (no data)
  */
-SDL_Texture* gfx_engine::getTexture(int i)
+bool gfx_engine::destroyStaticLayers(void *data)
 {
-    return textures[i];
+    freeStaticLayers();
+
+    return true;
+}
+
+void gfx_engine::freeStaticLayers()
+{
+    for (int l = 0; l < NUM_STATIC_LAYERS; ++l)
+    {
+        for (int i = 0; i < (int)static_chunks[l].size(); ++i)
+             SDL_DestroyTexture(static_chunks[l][i]);
+        static_chunks[l].clear();
+    }
+    static_chunk_columns = static_chunk_rows = 0;
+}
+
+int gfx_engine::getNumStaticChunks()
+{
+    return static_chunk_columns * static_chunk_rows;
+}
+
+/*
+ * Top left corner of chunk i in level coordinates
+ */
+point gfx_engine::getStaticChunkLoc(int i)
+{
+    return point((double)(i % static_chunk_columns),(double)(i / static_chunk_columns)) * getStaticChunkDim();
+}
+
+/*
+ * Size of a chunk in level coordinates
+ */
+point gfx_engine::getStaticChunkDim()
+{
+    return point((double)STATIC_CHUNK_DIM / 2.0,(double)STATIC_CHUNK_DIM / 2.0);
+}
+
+/*
+ * Call before drawing into the chunks (renderSprite draws into the current chunk
+ * until endStaticLayerBake is called)
+ */
+void gfx_engine::beginStaticLayerBake()
+{
+    baked_camera = camera;
+    baking_chunk = NULL;
+    sprite_batch.clear();
+}
+
+/*
+ * Direct renderSprite at chunk i of layer "layer"
+ * (the sprites batched for the previous chunk are drawn into that chunk first)
+ */
+void gfx_engine::beginStaticChunk(static_layer layer, int i)
+{
+    if (baking_chunk != NULL)
+        runOnRenderThread(&gfx_engine::drawStaticChunk,baking_chunk);
+    baking_chunk = static_chunks[(int)layer][i];
+    // renderSprite subtracts the camera, so placing it at the chunk's corner
+    // puts every sprite at its position inside the chunk
+    camera = getStaticChunkLoc(i) * 2.0;
+}
+
+void gfx_engine::endStaticLayerBake()
+{
+    if (baking_chunk != NULL)
+        runOnRenderThread(&gfx_engine::drawStaticChunk,baking_chunk);
+    baking_chunk = NULL;
+    camera = baked_camera;
+}
+
+/*
+ * Render call: clear a chunk (an SDL_Texture) and draw the batched sprites into it
+ */
+bool gfx_engine::drawStaticChunk(void *data)
+{
+    SDL_Color draw_color;
+    SDL_GetRenderDrawColor(renderer,&draw_color.r,&draw_color.g,&draw_color.b,&draw_color.a);
+
+    SDL_SetRenderTarget(renderer,(SDL_Texture *)data);
+    SDL_SetRenderDrawColor(renderer,0,0,0,0);
+    SDL_RenderClear(renderer);
+    drawSpriteList(&sprite_batch);
+
+    SDL_SetRenderTarget(renderer,NULL);
+    SDL_SetRenderDrawColor(renderer,draw_color.r,draw_color.g,draw_color.b,draw_color.a);
+
+    return true;
+}
+
+/*
+ * Draw the chunks of layer "layer" that overlap the camera (in the current sprite layer)
+ */
+void gfx_engine::renderStaticLayer(static_layer layer)
+{
+    SDL_Rect rect;
+    SDL_Rect crop = {0,0,STATIC_CHUNK_DIM,STATIC_CHUNK_DIM};
+    SDL_Color color = {255,255,255,255};
+
+    int min_column = std::max(0,(int)(camera.x() / STATIC_CHUNK_DIM));
+    int min_row = std::max(0,(int)(camera.y() / STATIC_CHUNK_DIM));
+    int max_column = std::min(static_chunk_columns - 1,(int)((camera.x() + WINDOW_WIDTH) / STATIC_CHUNK_DIM));
+    int max_row = std::min(static_chunk_rows - 1,(int)((camera.y() + WINDOW_HEIGHT) / STATIC_CHUNK_DIM));
+
+    for (int y = min_row; y <= max_row; ++y)
+    for (int x = min_column; x <= max_column; ++x)
+    {
+        // floor, so that chunk pixels land where renderSprite would have put them
+        rect.x = (int)std::floor(x * STATIC_CHUNK_DIM - camera.x());
+        rect.y = (int)std::floor(y * STATIC_CHUNK_DIM - camera.y());
+        rect.w = STATIC_CHUNK_DIM;
+        rect.h = STATIC_CHUNK_DIM;
+        addQuad(static_chunks[(int)layer][y * static_chunk_columns + x],crop,rect,color,SDL_FLIP_NONE);
+        num_sprites_drawn++;
+    }
 }
@@ -6,6 +6,91 @@
 
 #include "globals.h"
 #include "point.h"
+#include "loader.h"
+#include "bundle.h"
+
+// side of one static layer chunk in screen pixels (the level is drawn at scale 2)
+#define STATIC_CHUNK_DIM 512
+#define NUM_STATIC_LAYERS 2
+
+// largest texture atlas page (smaller if the renderer can't make one this big)
+#define MAX_ATLAS_DIM 4096
+// empty pixels around each image in an atlas, so that scaled sprites don't bleed
+#define ATLAS_PADDING 1
+// every sprite sheet plus the font
+#define NUM_ATLAS_IMAGES (NUM_TOTAL_TEXTURES + 1)
+#define FONT_ATLAS_IMAGE NUM_TOTAL_TEXTURES
+#define FONT_FILE_NAME "mainfont16x16.png"
+// the only sprite sheet the main menu needs
+#define MENU_BACKDROP_TEXTURE 59
+
+// number of bitmap strings whose glyph quads are kept, and the longest string kept
+#define TEXT_RUN_CACHE_SIZE 64
+#define MAX_TEXT_RUN_LENGTH 64
+
+// Level geometry that never moves is drawn once into chunked render targets.
+// Doors move, so they are drawn every frame between the two layers.
+enum static_layer
+{
+    STATICLAYER_BELOW_DOORS,
+    STATICLAYER_ABOVE_DOORS
+};
+
+// Draw passes of a frame, back to front. Sprites are batched and drawn when the
+// screen is updated, sorted by layer and then by texture, so anything that has to
+// be in front of something else must be in a later layer.
+enum sprite_layer
+{
+    SPRITELAYER_BACKDROP,
+    SPRITELAYER_STATIC_BELOW_DOORS,
+    SPRITELAYER_DOORS,
+    SPRITELAYER_STATIC_ABOVE_DOORS,
+    SPRITELAYER_NPCS,
+    SPRITELAYER_PROPS,
+    SPRITELAYER_PLAYER,
+    SPRITELAYER_ITEMS,
+    SPRITELAYER_SHADOWS,
+    SPRITELAYER_PARTICLES,
+    SPRITELAYER_HUD
+};
+
+// Where an image was packed: the atlas page it is on and its area on that page.
+// renderSprite crops frames and rows relative to the area.
+struct sprite_handle
+{
+    SDL_Texture *texture;
+    SDL_Rect area;
+};
+
+// One batched quad: the area of texture (NULL for a filled rectangle) drawn to
+// rect on the screen, multiplied by color
+struct sprite_quad
+{
+    sprite_layer layer;
+    SDL_Texture *texture;
+    SDL_Rect crop;
+    SDL_Rect rect;
+    SDL_Color color;
+    SDL_RendererFlip orientation;
+};
+
+// A bitmap string drawn at the same location in the same color as before reuses
+// the glyph quads built for it the first time (until it is the least recently used
+// run and another string takes its place)
+struct text_run
+{
+    char text[MAX_TEXT_RUN_LENGTH + 1];
+    SDL_Color color;
+    point loc;
+    std::vector<sprite_quad> glyphs;
+    // clearScreen count when the run was last drawn
+    int last_used;
+};
+
+class gfx_engine;
+
+// Renderer work done on the render thread (see gfx_engine::runOnRenderThread)
+typedef bool (gfx_engine::*render_call)(void *);
 
 static const std::string texture_file_names[NUM_TOTAL_TEXTURES] =
 {
@@ -97,23 +182,121 @@ class gfx_engine
     public:
         gfx_engine();
         ~gfx_engine();
-        SDL_Texture* getTexture(int);
+        sprite_handle getTexture(int);
         bool initSDL();
+        void queueTextureDecoding(asset_loader *);
+        bool loadEarlyTexture(asset_loader *, int);
+        bool buildTextureAtlases(asset_loader *);
+        bool loadTexturesFromBundle(asset_bundle *);
         void freeSDL();
-        void renderSprite(SDL_Texture *, point, point, point, int, int, SDL_RendererFlip, bool, SDL_Color, int);
+        void renderSprite(sprite_handle, point, point, point, int, int, SDL_RendererFlip, bool, SDL_Color, int);
+        bool isOnScreen(SDL_Rect);
+        void countCulledSprites(int);
+        int getNumSpritesDrawn();
+        int getNumSpritesCulled();
         void drawRectangle(SDL_Color,point,point);
         void addBitmapString(SDL_Color, std::string, point);
+        void addBitmapString(SDL_Color, const char *, point);
         void addBitmapCharacter(SDL_Color, int, point);
+        void setSpriteLayer(sprite_layer);
+        void startRenderThread();
+        void stopRenderThread();
+        void waitForRenderThread();
+        bool runOnRenderThread(render_call, void *);
+        void runRenderThread();
+        int getNumDrawCalls();
+        double getRenderWaitTime();
+        double getRenderThreadTime();
         void clearScreen();
         void updateScreen();
         void updateCamera(point,point);
         point getCamera();
+        void reloadTextures();
+        bool initStaticLayers(point);
+        void discardStaticLayers();
+        int getNumStaticChunks();
+        point getStaticChunkLoc(int);
+        point getStaticChunkDim();
+        void beginStaticLayerBake();
+        void beginStaticChunk(static_layer, int);
+        void endStaticLayerBake();
+        void renderStaticLayer(static_layer);
     private:
         SDL_Window* screen;
         SDL_Renderer* renderer;
-        SDL_Texture* textures[NUM_TOTAL_TEXTURES];
-        SDL_Texture* font_texture;
+        // atlas pages holding all sprite sheets and the font, and their pixels
+        // (kept to upload them again after a device reset)
+        std::vector<SDL_Texture*> atlas_pages;
+        std::vector<SDL_Surface*> atlas_page_images;
+        sprite_handle sprites[NUM_ATLAS_IMAGES];
+        // decoding job of each image, and the first image with the same file
+        int image_jobs[NUM_ATLAS_IMAGES];
+        int first_image_use[NUM_ATLAS_IMAGES];
+        // textures drawn before the atlases are built, and their images (owned by the asset loader)
+        std::vector<SDL_Texture*> early_textures;
+        std::vector<SDL_Surface*> early_texture_images;
+        bool buildTextureAtlases(SDL_Surface **);
+        bool finishTextureAtlases(SDL_Surface **, bool);
+        // render calls (the data each one takes is described where it is defined)
+        bool createRenderer(void *);
+        bool destroyRenderer(void *);
+        bool uploadEarlyTexture(void *);
+        bool uploadTextureAtlases(void *);
+        bool reuploadTextures(void *);
+        bool reuploadTexture(SDL_Texture **, SDL_Surface *);
+        bool createStaticLayers(void *);
+        bool drawStaticChunk(void *);
+        bool destroyStaticLayers(void *);
+        void freeStaticLayers();
         point camera;
+        // chunks of each static layer, row by row
+        std::vector<SDL_Texture*> static_chunks[NUM_STATIC_LAYERS];
+        int static_chunk_columns;
+        int static_chunk_rows;
+        point baked_camera;
+        // chunk the sprites recorded since beginStaticChunk are drawn into
+        SDL_Texture *baking_chunk;
+        // sprites sent to the renderer and sprites skipped since the last clearScreen
+        int num_sprites_drawn;
+        int num_sprites_culled;
+        // Draw lists: quads of the frame being recorded, and of the frame submitted to the
+        // render thread. Neither list is changed by the other thread until they are swapped.
+        std::vector<sprite_quad> sprite_batch;
+        std::vector<sprite_quad> submitted_batch;
+        // was clearScreen called for the recorded/submitted frame?
+        bool batch_clear;
+        bool submitted_clear;
+        // vertex and index arrays the quads are turned into
+        std::vector<SDL_Vertex> batch_vertices;
+        std::vector<int> batch_indices;
+        sprite_layer current_layer;
+        // SDL_RenderGeometry calls of the last presented frame
+        int num_draw_calls;
+        // The render thread creates the renderer and is the only thread that uses it. It
+        // draws and presents the submitted frame while the next one is simulated and
+        // recorded, and runs every other renderer call for the main thread, in order.
+        SDL_Thread *render_thread;
+        SDL_mutex *render_mutex;
+        SDL_cond *render_cond;
+        bool frame_submitted;
+        bool render_thread_quit;
+        bool call_pending;
+        render_call pending_call;
+        void *pending_call_data;
+        bool call_result;
+        // draw calls and time of the last frame, set by the render thread
+        int rendered_draw_calls;
+        double rendered_frame_ms;
+        // copy of rendered_frame_ms made by waitForRenderThread, and time updateScreen waited for the render thread
+        double render_thread_ms;
+        double render_wait_ms;
+        int drawSpriteList(std::vector<sprite_quad> *);
+        void addQuad(SDL_Texture *, SDL_Rect, SDL_Rect, SDL_Color, SDL_RendererFlip);
+        sprite_quad makeGlyphQuad(SDL_Color, int, point);
+        text_run *getTextRun(SDL_Color, const char *, point);
+        void clearTextRuns();
+        text_run text_runs[TEXT_RUN_CACHE_SIZE];
+        int frame_number;
 };
 
 #endif
@@ -29,7 +29,15 @@ void input::pollEvent()
                 plus_key_pressed = true;
             if (evt.key.keysym.sym == SDLK_MINUS)
                 minus_key_pressed = true;
+            if (evt.key.keysym.sym == SDLK_F3)
+                profiler_key_pressed = true;
+            if (evt.key.keysym.sym == SDLK_F4)
+                profiler_dump_key_pressed = true;
         }
+        if (evt.type == SDL_RENDER_TARGETS_RESET)
+            render_targets_reset = true;
+        if (evt.type == SDL_RENDER_DEVICE_RESET)
+            render_device_reset = true;
     }
 }
 
@@ -39,6 +47,8 @@ void input::processKey()
     on_ladder_key_pressed = off_ladder_key_pressed = down_ladder_key_pressed = use_level_feature_pressed = false;
     select_key_pressed = pause_key_pressed = shift_key_pressed = toggle_carry_item_pressed = false;
     plus_key_pressed = minus_key_pressed = false;
+    profiler_key_pressed = profiler_dump_key_pressed = false;
+    render_targets_reset = render_device_reset = false;
 
     pollEvent();
 
@@ -174,6 +184,26 @@ bool input::minusKeyPressed()
     return minus_key_pressed;
 }
 
+bool input::profilerKeyPressed()
+{
+    return profiler_key_pressed;
+}
+
+bool input::profilerDumpKeyPressed()
+{
+    return profiler_dump_key_pressed;
+}
+
+bool input::renderTargetsReset()
+{
+    return render_targets_reset;
+}
+
+bool input::renderDeviceReset()
+{
+    return render_device_reset;
+}
+
 bool input::noKeyPressed()
 {
     return !(jump_key_pressed || delta_key_pressed);
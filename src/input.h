@@ -53,6 +53,14 @@ class input
 
         bool toggleCarryItemKeyPressed();
 
+        bool profilerKeyPressed();
+
+        bool profilerDumpKeyPressed();
+
+        bool renderTargetsReset();
+
+        bool renderDeviceReset();
+
      private:
 	SDL_Event evt;
 	point delta;
@@ -71,6 +79,11 @@ class input
         bool toggle_carry_item_pressed;
         bool plus_key_pressed;
         bool minus_key_pressed;
+        bool profiler_key_pressed;
+        bool profiler_dump_key_pressed;
+        // the renderer lost the contents of its render targets (or all of its textures)
+        bool render_targets_reset;
+        bool render_device_reset;
 };
 
 #endif
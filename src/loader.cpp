@@ -0,0 +1,199 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+#include "loader.h"
+
+asset_loader::asset_loader()
+{
+    mutex = NULL;
+    job_done = NULL;
+    next_job = 0;
+    num_done = 0;
+    start_counter = 0;
+    decode_ms = work_ms = 0.0;
+}
+
+// Wait for the workers, and free every result that was never taken
+asset_loader::~asset_loader()
+{
+    waitForAll();
+
+    for (int i = 0; i < (int)threads.size(); ++i)
+        SDL_WaitThread(threads[i],NULL);
+
+    for (int i = 0; i < (int)jobs.size(); ++i)
+    {
+        if (jobs[i].result == NULL)
+            continue;
+        if (jobs[i].type == ASSETTYPE_IMAGE)
+            SDL_FreeSurface((SDL_Surface *)jobs[i].result);
+        else
+            Mix_FreeChunk((Mix_Chunk *)jobs[i].result);
+    }
+
+    if (job_done != NULL)
+        SDL_DestroyCond(job_done);
+    if (mutex != NULL)
+        SDL_DestroyMutex(mutex);
+}
+
+// Only before start. Returns the job's index.
+int asset_loader::addJob(asset_type type, std::string file_name)
+{
+    asset_job job;
+    job.type = type;
+    job.file_name = file_name;
+    job.result = NULL;
+    job.done = false;
+    jobs.push_back(job);
+    return (int)jobs.size() - 1;
+}
+
+static int SDLCALL assetWorkerMain(void *data)
+{
+    ((asset_loader *)data)->runWorker();
+    return 0;
+}
+
+// Start one worker per cpu (at most MAX_ASSET_THREADS). If no worker can be
+// started, every job is decoded right here.
+void asset_loader::start()
+{
+    start_counter = SDL_GetPerformanceCounter();
+    mutex = SDL_CreateMutex();
+    job_done = SDL_CreateCond();
+
+    int num_threads = std::max(1,std::min(MAX_ASSET_THREADS,SDL_GetCPUCount()));
+
+    if (mutex != NULL && job_done != NULL)
+    {
+        for (int i = 0; i < num_threads && i < (int)jobs.size(); ++i)
+        {
+            SDL_Thread *thread = SDL_CreateThread(assetWorkerMain,"asset decoder",this);
+            if (thread != NULL)
+                threads.push_back(thread);
+        }
+    }
+
+    if (threads.empty())
+    {
+        for (int i = 0; i < (int)jobs.size(); ++i)
+        {
+            decodeJob(i);
+            jobs[i].done = true;
+        }
+        next_job = num_done = (int)jobs.size();
+        decode_ms = (double)(SDL_GetPerformanceCounter() - start_counter) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+        work_ms = decode_ms;
+    }
+}
+
+// Worker thread: decode jobs in order until none are left
+void asset_loader::runWorker()
+{
+    SDL_LockMutex(mutex);
+    while (next_job < (int)jobs.size())
+    {
+        int i = next_job++;
+        SDL_UnlockMutex(mutex);
+
+        Uint64 job_start = SDL_GetPerformanceCounter();
+        decodeJob(i);
+        double ms = (double)(SDL_GetPerformanceCounter() - job_start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+        SDL_LockMutex(mutex);
+        jobs[i].done = true;
+        num_done++;
+        work_ms += ms;
+        if (num_done == (int)jobs.size())
+            decode_ms = (double)(SDL_GetPerformanceCounter() - start_counter) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+        SDL_CondBroadcast(job_done);
+    }
+    SDL_UnlockMutex(mutex);
+}
+
+// Decode job i (sets only its result, so no lock is needed)
+void asset_loader::decodeJob(int i)
+{
+    if (jobs[i].type == ASSETTYPE_IMAGE)
+    {
+        SDL_Surface *file_image = IMG_Load(jobs[i].file_name.c_str());
+        if (file_image != NULL)
+        {
+            jobs[i].result = SDL_ConvertSurfaceFormat(file_image,SDL_PIXELFORMAT_RGBA32,0);
+            SDL_FreeSurface(file_image);
+        }
+    }
+    else
+    {
+        jobs[i].result = Mix_LoadWAV(jobs[i].file_name.c_str());
+    }
+}
+
+bool asset_loader::isFinished()
+{
+    if (threads.empty())
+        return num_done == (int)jobs.size();
+
+    SDL_LockMutex(mutex);
+    bool finished = (num_done == (int)jobs.size());
+    SDL_UnlockMutex(mutex);
+    return finished;
+}
+
+void asset_loader::waitForJob(int i)
+{
+    if (threads.empty())
+        return;
+
+    SDL_LockMutex(mutex);
+    while (!jobs[i].done)
+        SDL_CondWait(job_done,mutex);
+    SDL_UnlockMutex(mutex);
+}
+
+void asset_loader::waitForAll()
+{
+    if (threads.empty())
+        return;
+
+    SDL_LockMutex(mutex);
+    while (num_done < (int)jobs.size())
+        SDL_CondWait(job_done,mutex);
+    SDL_UnlockMutex(mutex);
+}
+
+std::string asset_loader::getFileName(int i)
+{
+    return jobs[i].file_name;
+}
+
+// Result of job i (call waitForJob first). It still belongs to the loader.
+void *asset_loader::getResult(int i)
+{
+    return jobs[i].result;
+}
+
+// Result of job i (call waitForJob first). The caller has to free it.
+void *asset_loader::takeResult(int i)
+{
+    void *result = jobs[i].result;
+    jobs[i].result = NULL;
+    return result;
+}
+
+int asset_loader::getNumThreads()
+{
+    return (int)threads.size();
+}
+
+// (call waitForAll first)
+double asset_loader::getDecodeTime()
+{
+    return decode_ms;
+}
+
+double asset_loader::getWorkTime()
+{
+    return work_ms;
+}
@@ -0,0 +1,61 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+#ifndef LOADER_H_
+#define LOADER_H_
+
+#include "globals.h"
+
+#define MAX_ASSET_THREADS 8
+
+enum asset_type
+{
+    ASSETTYPE_IMAGE,
+    ASSETTYPE_SOUND
+};
+
+// One file to decode: an image becomes an RGBA32 SDL_Surface, a sound a Mix_Chunk.
+// result stays NULL if the file could not be loaded.
+struct asset_job
+{
+    asset_type type;
+    std::string file_name;
+    void *result;
+    bool done;
+};
+
+// Decodes asset files on a pool of worker threads. Jobs are added before start;
+// their results are handed over on the main thread (textures still have to be
+// uploaded to the renderer there). IMG_Init has to be called before start.
+class asset_loader
+{
+    public:
+        asset_loader();
+        ~asset_loader();
+        int addJob(asset_type, std::string);
+        void start();
+        bool isFinished();
+        void waitForJob(int);
+        void waitForAll();
+        std::string getFileName(int);
+        void *getResult(int);
+        void *takeResult(int);
+        int getNumThreads();
+        double getDecodeTime();
+        double getWorkTime();
+        void runWorker();
+    private:
+        std::vector<asset_job> jobs;
+        std::vector<SDL_Thread*> threads;
+        SDL_mutex *mutex;
+        SDL_cond *job_done;
+        int next_job;
+        int num_done;
+        Uint64 start_counter;
+        // time from start until the last job was done, and the decode time of all jobs added up
+        double decode_ms;
+        double work_ms;
+        void decodeJob(int);
+};
+
+#endif
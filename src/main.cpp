@@ -5,10 +5,41 @@
 
 int main(int argc, char* argv[])
 {
+    int headless_ticks = -1;
+    std::string profile_csv = "";
+    bool seed_given = false;
+    unsigned int seed = 0;
+
+    // --headless <ticks>: run the simulation only (no window, renderer or sound)
+    // --profile-csv <file>: write the frame profile to file on exit
+    // --seed <n>: seed for the random number generator (default: current time)
+    // --physics-selftest: check the SIMD physics kernels against the scalar one and exit
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--headless" && i + 1 < argc)
+            headless_ticks = atoi(argv[++i]);
+        else if (std::string(argv[i]) == "--profile-csv" && i + 1 < argc)
+            profile_csv = argv[++i];
+        else if (std::string(argv[i]) == "--seed" && i + 1 < argc)
+        {
+            seed = (unsigned int)strtoul(argv[++i],NULL,10);
+            seed_given = true;
+        }
+        else if (std::string(argv[i]) == "--physics-selftest")
+            return (runPhysicsKernelSelfTest() ? 0 : 1);
+    }
+
     // create instance of game obj (contains all program data)
     Game game;
+    if (seed_given)
+        game.setSeed(seed);
     // execute program
-    game.run();
+    if (headless_ticks >= 0)
+        game.runHeadless(headless_ticks);
+    else
+        game.run();
+    if (profile_csv != "" && !game.dumpProfile(profile_csv))
+        std::cout << "Could not write profile to " << profile_csv << "\n";
     // When "gfx_engine" instance goes out of scope, its
     // destructor is called freeing all SDL textures, the
     // renderer, window, etc... (implicitly)
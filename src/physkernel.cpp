@@ -0,0 +1,488 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+#include "physkernel.h"
+#include "game.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PHYSKERNEL_X86
+#include <immintrin.h>
+#endif
+
+// gcc and clang only emit SSE2/AVX2 instructions in functions built for them
+#if defined(PHYSKERNEL_X86) && defined(__GNUC__)
+#define PHYSKERNEL_TARGET_SSE2 __attribute__((target("sse2")))
+#define PHYSKERNEL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PHYSKERNEL_TARGET_SSE2
+#define PHYSKERNEL_TARGET_AVX2
+#endif
+
+// -1 until the first batch, then the fastest kernel the cpu supports (or the one set by setPhysicsKernel)
+static int active_physics_kernel = -1;
+
+// same as dynamic_entity::limitVelocity for one axis
+static inline double clampVelocity(double vel, double max_vel)
+{
+    return std::min(std::max(vel,-max_vel),max_vel);
+}
+
+// The "+ 0.0"s match the zero components added by dynamic_entity::incVelocity
+// (they turn -0.0 into 0.0), and the order of operations is the same as in Game.
+static void integrateEntryScalar(physics_batch b, int i, bool horizontal_acceleration, bool gravity)
+{
+    double vx = b.velocity_x[i];
+    double vy = b.velocity_y[i];
+
+    if (horizontal_acceleration)
+    {
+        vx = clampVelocity(vx + b.acceleration_x[i],b.max_velocity_x[i]);
+        vy = clampVelocity(vy + 0.0,b.max_velocity_y[i]);
+    }
+
+    vx = clampVelocity(vx * b.velocity_decrement_x[i],b.max_velocity_x[i]);
+    vy = clampVelocity(vy,b.max_velocity_y[i]);
+
+    if (std::abs(vx) <= b.stop_velocity_x[i])
+        vx = 0.0;
+
+    if (gravity)
+    {
+        vx = clampVelocity(vx + 0.0,b.max_velocity_x[i]);
+        vy = clampVelocity(vy + GRAVITY_VELOCITY_INCREMENT,b.max_velocity_y[i]);
+    }
+
+    b.old_loc_x[i] = b.loc_x[i];
+    b.old_loc_y[i] = b.loc_y[i];
+    b.loc_x[i] += vx;
+    b.loc_y[i] += vy;
+    b.velocity_x[i] = vx;
+    b.velocity_y[i] = vy;
+}
+
+static void integrateScalar(physics_batch b, int first, bool horizontal_acceleration, bool gravity)
+{
+    for (int i = first; i < b.count; ++i)
+    {
+        if (b.selected[i])
+            integrateEntryScalar(b,i,horizontal_acceleration,gravity);
+    }
+}
+
+#ifdef PHYSKERNEL_X86
+
+// max(-max_vel,vel) then min(max_vel,..) picks the same operand as clampVelocity in every case
+// (the negation flips the sign bit like the unary minus does)
+PHYSKERNEL_TARGET_SSE2 static inline __m128d clampVelocitySSE2(__m128d vel, __m128d max_vel)
+{
+    __m128d neg_max_vel = _mm_xor_pd(max_vel,_mm_set1_pd(-0.0));
+    return _mm_min_pd(max_vel,_mm_max_pd(neg_max_vel,vel));
+}
+
+// new_val where mask is set, else old_val
+PHYSKERNEL_TARGET_SSE2 static inline __m128d selectSSE2(__m128d mask, __m128d new_val, __m128d old_val)
+{
+    return _mm_or_pd(_mm_and_pd(mask,new_val),_mm_andnot_pd(mask,old_val));
+}
+
+PHYSKERNEL_TARGET_SSE2 static void integrateSSE2(physics_batch b, bool horizontal_acceleration, bool gravity)
+{
+    const __m128d sign_bit = _mm_set1_pd(-0.0);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d gravity_increment = _mm_set1_pd(GRAVITY_VELOCITY_INCREMENT);
+    int i = 0;
+
+    for (; i + 2 <= b.count; i += 2)
+    {
+        if (!(b.selected[i] | b.selected[i+1]))
+            continue;
+
+        __m128d mask = _mm_castsi128_pd(_mm_set_epi64x(b.selected[i+1] ? -1 : 0,b.selected[i] ? -1 : 0));
+        __m128d max_vx = _mm_loadu_pd(b.max_velocity_x + i);
+        __m128d max_vy = _mm_loadu_pd(b.max_velocity_y + i);
+        __m128d old_vx = _mm_loadu_pd(b.velocity_x + i);
+        __m128d old_vy = _mm_loadu_pd(b.velocity_y + i);
+        __m128d vx = old_vx;
+        __m128d vy = old_vy;
+
+        if (horizontal_acceleration)
+        {
+            vx = clampVelocitySSE2(_mm_add_pd(vx,_mm_loadu_pd(b.acceleration_x + i)),max_vx);
+            vy = clampVelocitySSE2(_mm_add_pd(vy,zero),max_vy);
+        }
+
+        vx = clampVelocitySSE2(_mm_mul_pd(vx,_mm_loadu_pd(b.velocity_decrement_x + i)),max_vx);
+        vy = clampVelocitySSE2(vy,max_vy);
+        vx = _mm_andnot_pd(_mm_cmple_pd(_mm_andnot_pd(sign_bit,vx),_mm_loadu_pd(b.stop_velocity_x + i)),vx);
+
+        if (gravity)
+        {
+            vx = clampVelocitySSE2(_mm_add_pd(vx,zero),max_vx);
+            vy = clampVelocitySSE2(_mm_add_pd(vy,gravity_increment),max_vy);
+        }
+
+        __m128d lx = _mm_loadu_pd(b.loc_x + i);
+        __m128d ly = _mm_loadu_pd(b.loc_y + i);
+        _mm_storeu_pd(b.old_loc_x + i,selectSSE2(mask,lx,_mm_loadu_pd(b.old_loc_x + i)));
+        _mm_storeu_pd(b.old_loc_y + i,selectSSE2(mask,ly,_mm_loadu_pd(b.old_loc_y + i)));
+        _mm_storeu_pd(b.loc_x + i,selectSSE2(mask,_mm_add_pd(lx,vx),lx));
+        _mm_storeu_pd(b.loc_y + i,selectSSE2(mask,_mm_add_pd(ly,vy),ly));
+        _mm_storeu_pd(b.velocity_x + i,selectSSE2(mask,vx,old_vx));
+        _mm_storeu_pd(b.velocity_y + i,selectSSE2(mask,vy,old_vy));
+    }
+
+    integrateScalar(b,i,horizontal_acceleration,gravity);
+}
+
+PHYSKERNEL_TARGET_AVX2 static inline __m256d clampVelocityAVX2(__m256d vel, __m256d max_vel)
+{
+    __m256d neg_max_vel = _mm256_xor_pd(max_vel,_mm256_set1_pd(-0.0));
+    return _mm256_min_pd(max_vel,_mm256_max_pd(neg_max_vel,vel));
+}
+
+PHYSKERNEL_TARGET_AVX2 static void integrateAVX2(physics_batch b, bool horizontal_acceleration, bool gravity)
+{
+    const __m256d sign_bit = _mm256_set1_pd(-0.0);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d gravity_increment = _mm256_set1_pd(GRAVITY_VELOCITY_INCREMENT);
+    int i = 0;
+
+    for (; i + 4 <= b.count; i += 4)
+    {
+        int flags = 0;
+        memcpy(&flags,b.selected + i,4);
+
+        if (flags == 0)
+            continue;
+
+        // widen the 4 select flags to 4 all-ones/all-zeros 64 bit lanes
+        __m256i wide_flags = _mm256_cvtepi8_epi64(_mm_cvtsi32_si128(flags));
+        __m256d mask = _mm256_castsi256_pd(_mm256_cmpgt_epi64(wide_flags,_mm256_setzero_si256()));
+        __m256d max_vx = _mm256_loadu_pd(b.max_velocity_x + i);
+        __m256d max_vy = _mm256_loadu_pd(b.max_velocity_y + i);
+        __m256d old_vx = _mm256_loadu_pd(b.velocity_x + i);
+        __m256d old_vy = _mm256_loadu_pd(b.velocity_y + i);
+        __m256d vx = old_vx;
+        __m256d vy = old_vy;
+
+        if (horizontal_acceleration)
+        {
+            vx = clampVelocityAVX2(_mm256_add_pd(vx,_mm256_loadu_pd(b.acceleration_x + i)),max_vx);
+            vy = clampVelocityAVX2(_mm256_add_pd(vy,zero),max_vy);
+        }
+
+        vx = clampVelocityAVX2(_mm256_mul_pd(vx,_mm256_loadu_pd(b.velocity_decrement_x + i)),max_vx);
+        vy = clampVelocityAVX2(vy,max_vy);
+        vx = _mm256_andnot_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign_bit,vx),_mm256_loadu_pd(b.stop_velocity_x + i),_CMP_LE_OQ),vx);
+
+        if (gravity)
+        {
+            vx = clampVelocityAVX2(_mm256_add_pd(vx,zero),max_vx);
+            vy = clampVelocityAVX2(_mm256_add_pd(vy,gravity_increment),max_vy);
+        }
+
+        __m256d lx = _mm256_loadu_pd(b.loc_x + i);
+        __m256d ly = _mm256_loadu_pd(b.loc_y + i);
+        _mm256_storeu_pd(b.old_loc_x + i,_mm256_blendv_pd(_mm256_loadu_pd(b.old_loc_x + i),lx,mask));
+        _mm256_storeu_pd(b.old_loc_y + i,_mm256_blendv_pd(_mm256_loadu_pd(b.old_loc_y + i),ly,mask));
+        _mm256_storeu_pd(b.loc_x + i,_mm256_blendv_pd(lx,_mm256_add_pd(lx,vx),mask));
+        _mm256_storeu_pd(b.loc_y + i,_mm256_blendv_pd(ly,_mm256_add_pd(ly,vy),mask));
+        _mm256_storeu_pd(b.velocity_x + i,_mm256_blendv_pd(old_vx,vx,mask));
+        _mm256_storeu_pd(b.velocity_y + i,_mm256_blendv_pd(old_vy,vy,mask));
+    }
+
+    integrateScalar(b,i,horizontal_acceleration,gravity);
+}
+
+#endif
+
+// Integrate every selected entry as an entity with physics type "pst" (PHYSTYPE_OFF does nothing)
+void integratePhysicsBatchWithKernel(physics_batch b, physics_type pst, physics_kernel_type kernel)
+{
+    if (pst == PHYSTYPE_OFF)
+        return;
+
+    bool horizontal_acceleration = (pst != PHYSTYPE_NO_HORIZ_ACC && pst != PHYSTYPE_NO_HORIZ_OR_GRAV_ACC);
+    bool gravity = (pst != PHYSTYPE_NO_HORIZ_OR_GRAV_ACC);
+
+    switch(kernel)
+    {
+#ifdef PHYSKERNEL_X86
+        case(PHYSKERNEL_SSE2):
+            integrateSSE2(b,horizontal_acceleration,gravity);
+            break;
+        case(PHYSKERNEL_AVX2):
+            integrateAVX2(b,horizontal_acceleration,gravity);
+            break;
+#endif
+        default:
+            integrateScalar(b,0,horizontal_acceleration,gravity);
+            break;
+    }
+}
+
+void integratePhysicsBatch(physics_batch b, physics_type pst)
+{
+    integratePhysicsBatchWithKernel(b,pst,getPhysicsKernel());
+}
+
+bool physicsKernelSupported(physics_kernel_type kernel)
+{
+    switch(kernel)
+    {
+        case(PHYSKERNEL_SCALAR):
+            return true;
+#ifdef PHYSKERNEL_X86
+        case(PHYSKERNEL_SSE2):
+            return SDL_HasSSE2() == SDL_TRUE;
+        case(PHYSKERNEL_AVX2):
+            return SDL_HasAVX2() == SDL_TRUE;
+#endif
+        default:
+            break;
+    }
+    return false;
+}
+
+// Unsupported kernels fall back to the scalar one
+void setPhysicsKernel(physics_kernel_type kernel)
+{
+    active_physics_kernel = (physicsKernelSupported(kernel) ? (int)kernel : (int)PHYSKERNEL_SCALAR);
+}
+
+physics_kernel_type getPhysicsKernel()
+{
+    if (active_physics_kernel == -1)
+    {
+        active_physics_kernel = (int)PHYSKERNEL_SCALAR;
+        for (int i = NUM_PHYSICS_KERNELS - 1; i > 0; --i)
+        {
+            if (physicsKernelSupported((physics_kernel_type)i))
+            {
+                active_physics_kernel = i;
+                break;
+            }
+        }
+    }
+
+    return (physics_kernel_type)active_physics_kernel;
+}
+
+std::string getPhysicsKernelName(physics_kernel_type kernel)
+{
+    switch(kernel)
+    {
+        case(PHYSKERNEL_SCALAR):
+            return "scalar";
+        case(PHYSKERNEL_SSE2):
+            return "sse2";
+        case(PHYSKERNEL_AVX2):
+            return "avx2";
+        default:
+            break;
+    }
+    return "";
+}
+
+// storage for one self test batch
+struct physics_test_data
+{
+    std::vector<double> fields[11];
+    std::vector<char> selected;
+    physics_batch getBatch();
+};
+
+// inputs of one self test entry that only dynamic_entity has
+struct physics_test_entity_data
+{
+    std::vector<double> speed_up_factor;
+    std::vector<double> xdelta_normal;
+};
+
+physics_batch physics_test_data::getBatch()
+{
+    physics_batch b;
+    b.loc_x = &fields[0][0];
+    b.loc_y = &fields[1][0];
+    b.old_loc_x = &fields[2][0];
+    b.old_loc_y = &fields[3][0];
+    b.velocity_x = &fields[4][0];
+    b.velocity_y = &fields[5][0];
+    b.max_velocity_x = &fields[6][0];
+    b.max_velocity_y = &fields[7][0];
+    b.acceleration_x = &fields[8][0];
+    b.velocity_decrement_x = &fields[9][0];
+    b.stop_velocity_x = &fields[10][0];
+    b.selected = &selected[0];
+    b.count = (int)selected.size();
+    return b;
+}
+
+// Run the self test batch through real dynamic_entitys with the same steps as
+// Game::applyPhysicsForDynamicEntity (without the collisions), and compare the
+// locations and velocities bit for bit against the scalar kernel.
+static bool runDynamicEntitySelfTest(const physics_test_data &initial, const physics_test_entity_data &entity_data,
+                                     const physics_type *test_types, int num_ticks)
+{
+    int num_entries = (int)initial.selected.size();
+    physics_test_data expected = initial;
+    std::vector<dynamic_entity> entities(num_entries);
+
+    for (int i = 0; i < num_entries; ++i)
+    {
+        initial_dynamic_entity_fields idef;
+        idef.dimensions = point(1.0,1.0);
+        idef.max_velocity = point(initial.fields[6][i],initial.fields[7][i]);
+        idef.horizontal_velocity_decrement = initial.fields[9][i];
+        idef.speed_up_factor = entity_data.speed_up_factor[i];
+        idef.horizontal_stop_velocity = initial.fields[10][i];
+        idef.num_frames = 1;
+        idef.animation_speed = 1;
+        idef.texture_index = 0;
+
+        dynamic_entity *de = &entities[i];
+        de->setDynamicEntityFields(idef,point(initial.fields[2][i],initial.fields[3][i]),0);
+        de->saveLoc();
+        de->setLoc(point(initial.fields[0][i],initial.fields[1][i]));
+        de->setXDeltaNormal(entity_data.xdelta_normal[i]);
+        // set the velocity without limits, so out of range velocities (like the ones
+        // restrictLoc sets) start out the same as in the batch
+        de->setMaxVelocity(point(std::numeric_limits<double>::infinity(),std::numeric_limits<double>::infinity()));
+        de->setVelocity(point(initial.fields[4][i],initial.fields[5][i]));
+        de->setMaxVelocity(idef.max_velocity);
+    }
+
+    bool passed = true;
+
+    for (int t = 0; t < num_ticks && passed; ++t)
+    {
+        integratePhysicsBatchWithKernel(expected.getBatch(),test_types[t % 3],PHYSKERNEL_SCALAR);
+
+        for (int i = 0; i < num_entries; ++i)
+        {
+            dynamic_entity *de = &entities[i];
+
+            if (initial.selected[i])
+            {
+                de->togglePhysics(test_types[t % 3]);
+                de->saveLoc();
+                Game::applyHorizontalAcceleration(de);
+                Game::applyHorizontalResistance(de);
+                Game::applyGravity(de);
+                Game::offsetEntityLoc(de);
+            }
+
+            const double actual[6] = {de->getLoc().x(), de->getLoc().y(), de->getOldLoc().x(), de->getOldLoc().y(),
+                                      de->getVelocity().x(), de->getVelocity().y()};
+
+            for (int f = 0; f < 6; ++f)
+            {
+                if (memcmp(&expected.fields[f][i],&actual[f],sizeof(double)) != 0)
+                    passed = false;
+            }
+        }
+    }
+
+    return passed;
+}
+
+// Run random batches (with signed zeros, values at the velocity limits and values around
+// the stop velocity mixed in) through every supported kernel for a few hundred ticks and
+// compare the results bit for bit against the scalar kernel, which is itself checked
+// against dynamic_entity. Prints one line per kernel.
+bool runPhysicsKernelSelfTest()
+{
+    // not a multiple of 4 so the scalar tails get tested too
+    const int num_entries = 1003;
+    const int num_ticks = 300;
+    const physics_type test_types[3] = {PHYSTYPE_FULL, PHYSTYPE_NO_HORIZ_ACC, PHYSTYPE_NO_HORIZ_OR_GRAV_ACC};
+    std::mt19937 gen(12345);
+    std::uniform_real_distribution<double> dist(-40.0,40.0);
+    std::uniform_real_distribution<double> unit_dist(-1.0,1.0);
+    physics_test_data initial;
+    physics_test_entity_data entity_data;
+
+    for (int f = 0; f < 11; ++f)
+        initial.fields[f].resize(num_entries);
+    initial.selected.resize(num_entries);
+    entity_data.speed_up_factor.resize(num_entries);
+    entity_data.xdelta_normal.resize(num_entries);
+
+    for (int i = 0; i < num_entries; ++i)
+    {
+        for (int f = 0; f < 11; ++f)
+            initial.fields[f][i] = dist(gen);
+
+        initial.fields[6][i] = std::abs(initial.fields[6][i]);
+        initial.fields[7][i] = std::abs(initial.fields[7][i]);
+        initial.fields[9][i] = 0.5 + std::abs(initial.fields[9][i]) / 80.0;
+        initial.fields[10][i] = std::abs(initial.fields[10][i]) / 8.0;
+        entity_data.speed_up_factor[i] = 1.0 + std::abs(dist(gen)) / 4.0;
+        entity_data.xdelta_normal[i] = unit_dist(gen);
+
+        switch(i % 8)
+        {
+            case(0):
+                initial.fields[4][i] = -0.0;
+                initial.fields[5][i] = -0.0;
+                break;
+            case(1):
+                initial.fields[4][i] = -initial.fields[6][i];
+                initial.fields[5][i] = initial.fields[7][i];
+                break;
+            case(2):
+                initial.fields[4][i] = initial.fields[10][i];
+                entity_data.xdelta_normal[i] = 0.0;
+                break;
+            case(3):
+                initial.fields[6][i] = 0.0;
+                break;
+            default:
+                break;
+        }
+
+        // same as prop_pool::setXDeltaNormal
+        initial.fields[8][i] = (initial.fields[6][i]/entity_data.speed_up_factor[i])*entity_data.xdelta_normal[i];
+
+        initial.selected[i] = (char)(gen() % 4 != 0);
+    }
+
+    bool all_passed = runDynamicEntitySelfTest(initial,entity_data,test_types,num_ticks);
+
+    std::cout << "physics kernel scalar vs dynamic_entity: " << (all_passed ? "ok" : "MISMATCH") << "\n";
+
+    for (int k = 1; k < NUM_PHYSICS_KERNELS; ++k)
+    {
+        if (!physicsKernelSupported((physics_kernel_type)k))
+        {
+            std::cout << "physics kernel " << getPhysicsKernelName((physics_kernel_type)k) << ": not supported by this cpu\n";
+            continue;
+        }
+
+        physics_test_data expected = initial;
+        physics_test_data result = initial;
+        bool passed = true;
+
+        for (int t = 0; t < num_ticks && passed; ++t)
+        {
+            integratePhysicsBatchWithKernel(expected.getBatch(),test_types[t % 3],PHYSKERNEL_SCALAR);
+            integratePhysicsBatchWithKernel(result.getBatch(),test_types[t % 3],(physics_kernel_type)k);
+
+            for (int f = 0; f < 6; ++f)
+            {
+                if (memcmp(&expected.fields[f][0],&result.fields[f][0],num_entries * sizeof(double)) != 0)
+                    passed = false;
+            }
+        }
+
+        std::cout << "physics kernel " << getPhysicsKernelName((physics_kernel_type)k) << ": " << (passed ? "ok" : "MISMATCH") << "\n";
+
+        all_passed = all_passed && passed;
+    }
+
+    return all_passed;
+}
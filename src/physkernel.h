@@ -0,0 +1,49 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+#ifndef PHYSKERNEL_H_
+#define PHYSKERNEL_H_
+
+#include "globals.h"
+#include "entity.h"
+
+#define NUM_PHYSICS_KERNELS 3
+
+// Batch versions of applyHorizontalAcceleration, applyHorizontalResistance,
+// applyGravity and offsetEntityLoc for structure-of-arrays storage (see prop_pool).
+// Every kernel gives bit-identical results to the scalar one (--physics-selftest checks this).
+enum physics_kernel_type
+{
+    PHYSKERNEL_SCALAR,
+    PHYSKERNEL_SSE2,
+    PHYSKERNEL_AVX2
+};
+
+// One array per field, "count" entries each.
+// Only entries with a nonzero "selected" flag are changed.
+struct physics_batch
+{
+    double *loc_x;
+    double *loc_y;
+    double *old_loc_x;
+    double *old_loc_y;
+    double *velocity_x;
+    double *velocity_y;
+    const double *max_velocity_x;
+    const double *max_velocity_y;
+    const double *acceleration_x;
+    const double *velocity_decrement_x;
+    const double *stop_velocity_x;
+    const char *selected;
+    int count;
+};
+
+void integratePhysicsBatch(physics_batch, physics_type);
+void integratePhysicsBatchWithKernel(physics_batch, physics_type, physics_kernel_type);
+bool physicsKernelSupported(physics_kernel_type);
+void setPhysicsKernel(physics_kernel_type);
+physics_kernel_type getPhysicsKernel();
+std::string getPhysicsKernelName(physics_kernel_type);
+bool runPhysicsKernelSelfTest();
+
+#endif
@@ -6,42 +6,73 @@
 
 #include <cmath>
 
+// Header only 2D vector (everything inlines, and constant expressions fold at compile time).
+// Define POINT_FLOAT_STORAGE to store coordinates as floats (halves the size of a point,
+// but changes results, so replays and benchmarks are only comparable within one mode).
+#ifdef POINT_FLOAT_STORAGE
+typedef float point_value;
+#else
+typedef double point_value;
+#endif
+
 class point
 {
 	public:
 		// default const.
- 		point();
- 		// copy const.
- 		point(double, double);
- 		// set...
-		void set(double, double);
+		constexpr point() : x_val(0), y_val(0) {}
+		constexpr point(double xx, double yy) : x_val((point_value)xx), y_val((point_value)yy) {}
+		// set...
+		void set(double xx, double yy) { x_val = (point_value)xx; y_val = (point_value)yy; }
 		// set y only
-		void sety(double);
+		void sety(double yy) { y_val = (point_value)yy; }
 		// set x only
-		void setx(double);
+		void setx(double xx) { x_val = (point_value)xx; }
 		// get y value of point.
-		double y();
+		constexpr double y() const { return y_val; }
 		// get x value of point.
-		double x();
-		// assignment overload
-		point operator=(point);
+		constexpr double x() const { return x_val; }
+		constexpr point operator+(point p) const { return point(x_val + p.x_val,y_val + p.y_val); }
+		constexpr point operator-(point p) const { return point(x_val - p.x_val,y_val - p.y_val); }
+		// component-wise product
+		constexpr point operator*(point p) const { return point(x_val * p.x_val,y_val * p.y_val); }
+		constexpr point operator*(double s) const { return point(x_val * s,y_val * s); }
+		constexpr bool operator==(point p) const { return x_val == p.x_val && y_val == p.y_val; }
+		constexpr bool operator!=(point p) const { return !(*this == p); }
+		point & operator+=(point p) { x_val += p.x_val; y_val += p.y_val; return *this; }
 	private:
 		// member variables for x and y coord.
-		double x_val,y_val;
+		point_value x_val,y_val;
 };
 
-bool inRange(point, point, point);
-
-bool isAt(point, point);
+constexpr bool inRange(point p, point rmin, point rmax)
+{
+	return (p.x() >= rmin.x() && p.y() >= rmin.y() && p.x() <= rmax.x() && p.y() <= rmax.y());
+}
 
-int distanceLongestAxis(point, point);
+constexpr bool isAt(point a, point b)
+{
+	return a == b;
+}
 
-point addPoints(point, point);
+// std::abs is not constexpr
+constexpr double pointAbs(double v)
+{
+	return (v < 0.0 ? -v : v);
+}
 
-point multPoints(point, point);
+constexpr int distanceLongestAxis(point a, point b)
+{
+	return (pointAbs(a.y() - b.y()) > pointAbs(a.x() - b.x())) ? (int)pointAbs(a.y() - b.y()) : (int)pointAbs(a.x() - b.x());
+}
 
-point getMidpoint(point, point);
+constexpr point getMidpoint(point a, point b)
+{
+	return point((a.x()+b.x())/2.0,(a.y()+b.y())/2.0);
+}
 
-double distanceSquared(point,point);
+constexpr double distanceSquared(point a, point b)
+{
+	return ((b.x() - a.x()) * (b.x() - a.x())) + ((b.y() - a.y()) * (b.y() - a.y()));
+}
 
 #endif
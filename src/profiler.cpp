@@ -0,0 +1,266 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+#include "profiler.h"
+#include <cmath>
+#include <iomanip>
+
+frame_profiler::frame_profiler()
+{
+    history.resize(PROFILER_HISTORY_SIZE);
+    phase_times.reserve(PROFILER_HISTORY_SIZE);
+    overlay_visible = false;
+    reset();
+}
+
+// Forget all recorded frames
+void frame_profiler::reset()
+{
+    next_frame = 0;
+    num_frames = 0;
+    total_frames = 0;
+    phase_stats_valid = false;
+
+    for (int i = 0; i < NUM_PROFILE_PHASES; ++i)
+    {
+        current_frame.phase_ms[i] = 0.0;
+        total_phase_ms[i] = 0.0;
+        phase_start[i] = 0;
+    }
+
+    for (int i = 0; i < NUM_PROFILE_COUNTERS; ++i)
+    {
+        current_frame.counters[i] = 0;
+        peak_counters[i] = 0;
+    }
+}
+
+void frame_profiler::beginFrame()
+{
+    for (int i = 0; i < NUM_PROFILE_PHASES; ++i)
+        current_frame.phase_ms[i] = 0.0;
+
+    for (int i = 0; i < NUM_PROFILE_COUNTERS; ++i)
+        current_frame.counters[i] = 0;
+}
+
+// Store the current frame in the ring buffer (overwriting the oldest one when full)
+void frame_profiler::endFrame()
+{
+    history[next_frame] = current_frame;
+    next_frame = (next_frame + 1) % PROFILER_HISTORY_SIZE;
+    if (num_frames < PROFILER_HISTORY_SIZE)
+        num_frames++;
+
+    total_frames++;
+    phase_stats_valid = false;
+
+    for (int i = 0; i < NUM_PROFILE_PHASES; ++i)
+        total_phase_ms[i] += current_frame.phase_ms[i];
+
+    for (int i = 0; i < NUM_PROFILE_COUNTERS; ++i)
+        peak_counters[i] = std::max(peak_counters[i],current_frame.counters[i]);
+}
+
+void frame_profiler::beginPhase(profile_phase phase)
+{
+    phase_start[(int)phase] = SDL_GetPerformanceCounter();
+}
+
+// A phase can be entered more than once per frame, so times accumulate.
+void frame_profiler::endPhase(profile_phase phase)
+{
+    Uint64 elapsed = SDL_GetPerformanceCounter() - phase_start[(int)phase];
+    current_frame.phase_ms[(int)phase] += (double)elapsed * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// For phases timed somewhere else (i.e. on another thread)
+void frame_profiler::setPhaseTime(profile_phase phase, double ms)
+{
+    current_frame.phase_ms[(int)phase] = ms;
+}
+
+void frame_profiler::setCounter(profile_counter counter, int value)
+{
+    current_frame.counters[(int)counter] = value;
+}
+
+void frame_profiler::toggleOverlay()
+{
+    overlay_visible = !overlay_visible;
+}
+
+bool frame_profiler::overlayVisible()
+{
+    return overlay_visible;
+}
+
+int frame_profiler::getNumFrames()
+{
+    return num_frames;
+}
+
+int frame_profiler::getTotalFrames()
+{
+    return total_frames;
+}
+
+double frame_profiler::getTotalPhaseTime(profile_phase phase)
+{
+    return total_phase_ms[(int)phase];
+}
+
+int frame_profiler::getPeakCounter(profile_counter counter)
+{
+    return peak_counters[(int)counter];
+}
+
+// get ith recorded frame, 0 being the oldest one still in the ring buffer
+// (i must be less than getNumFrames)
+profile_frame frame_profiler::getFrame(int i)
+{
+    int oldest = (num_frames < PROFILER_HISTORY_SIZE) ? 0 : next_frame;
+    return history[(oldest + i) % PROFILER_HISTORY_SIZE];
+}
+
+profile_phase_stats frame_profiler::getPhaseStats(profile_phase phase)
+{
+    if (!phase_stats_valid)
+        computePhaseStats();
+
+    return phase_stats[(int)phase];
+}
+
+// min, mean and p99 of every phase over the ring buffer (all zero without frames)
+void frame_profiler::computePhaseStats()
+{
+    int p99_index = std::max(0, (int)std::ceil(0.99 * (double)num_frames) - 1);
+
+    for (int p = 0; p < NUM_PROFILE_PHASES; ++p)
+    {
+        profile_phase_stats stats = {0.0, 0.0, 0.0};
+
+        if (num_frames > 0)
+        {
+            phase_times.clear();
+            for (int i = 0; i < num_frames; ++i)
+                phase_times.push_back(history[i].phase_ms[p]);
+
+            double total = 0.0;
+            for (int i = 0; i < num_frames; ++i)
+                total += phase_times[i];
+
+            stats.min_ms = *std::min_element(phase_times.begin(), phase_times.end());
+            stats.mean_ms = total / (double)num_frames;
+            // only the p99 element has to be in its sorted place
+            std::nth_element(phase_times.begin(), phase_times.begin() + p99_index, phase_times.end());
+            stats.p99_ms = phase_times[p99_index];
+        }
+
+        phase_stats[p] = stats;
+    }
+
+    phase_stats_valid = true;
+}
+
+// Write the per-phase summary (min, mean, p99) followed by every frame in the ring buffer
+bool frame_profiler::writeCSV(std::string file_name)
+{
+    std::ofstream csv_file(file_name.c_str());
+
+    if (!csv_file.is_open())
+        return false;
+
+    csv_file << "phase,min_ms,mean_ms,p99_ms\n";
+    for (int i = 0; i < NUM_PROFILE_PHASES; ++i)
+    {
+        profile_phase_stats stats = getPhaseStats((profile_phase)i);
+        csv_file << getProfilePhaseName((profile_phase)i) << "," << stats.min_ms << "," << stats.mean_ms << "," << stats.p99_ms << "\n";
+    }
+
+    csv_file << "\nframe";
+    for (int i = 0; i < NUM_PROFILE_PHASES; ++i)
+        csv_file << "," << getProfilePhaseName((profile_phase)i) << "_ms";
+    for (int i = 0; i < NUM_PROFILE_COUNTERS; ++i)
+        csv_file << "," << getProfileCounterName((profile_counter)i);
+    csv_file << "\n";
+
+    for (int f = 0; f < num_frames; ++f)
+    {
+        profile_frame frame = getFrame(f);
+        csv_file << f;
+        for (int i = 0; i < NUM_PROFILE_PHASES; ++i)
+            csv_file << "," << frame.phase_ms[i];
+        for (int i = 0; i < NUM_PROFILE_COUNTERS; ++i)
+            csv_file << "," << frame.counters[i];
+        csv_file << "\n";
+    }
+
+    return true;
+}
+
+std::string getProfilePhaseName(profile_phase phase)
+{
+    switch(phase)
+    {
+        case(PROFPHASE_PROCESSACTIONS):
+            return "processActions";
+        case(PROFPHASE_APPLYAI):
+            return "applyAI";
+        case(PROFPHASE_APPLYPHYSICS):
+            return "applyPhysics";
+        case(PROFPHASE_ENTITYDELETION):
+            return "entityDeletion";
+        case(PROFPHASE_PARTICLEEFFECTS):
+            return "particleEffects";
+        case(PROFPHASE_UPDATEANIMATIONS):
+            return "updateAnimations";
+        case(PROFPHASE_RENDERTEXTURES):
+            return "renderTextures";
+        case(PROFPHASE_RENDERWAIT):
+            return "renderWait";
+        case(PROFPHASE_RENDERTHREAD):
+            return "renderThread";
+        default:
+            break;
+    }
+    return "";
+}
+
+std::string getProfileCounterName(profile_counter counter)
+{
+    switch(counter)
+    {
+        case(PROFCOUNT_NPCS):
+            return "npcs";
+        case(PROFCOUNT_PROPS):
+            return "props";
+        case(PROFCOUNT_PARTICLES):
+            return "particles";
+        case(PROFCOUNT_WALLS):
+            return "walls";
+        case(PROFCOUNT_WALLRECTS):
+            return "wall_rects";
+        case(PROFCOUNT_DELETIONS):
+            return "deletions";
+        case(PROFCOUNT_LEVELHEAPALLOCS):
+            return "level_heap_allocs";
+        case(PROFCOUNT_SPRITESDRAWN):
+            return "sprites_drawn";
+        case(PROFCOUNT_SPRITESCULLED):
+            return "sprites_culled";
+        case(PROFCOUNT_DRAWCALLS):
+            return "draw_calls";
+        default:
+            break;
+    }
+    return "";
+}
+
+// right aligned millisecond value, 6 characters wide
+std::string formatProfileTime(double ms)
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2) << std::setw(6) << ms;
+    return ss.str();
+}
@@ -0,0 +1,100 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include "globals.h"
+
+// number of recent frames kept for statistics (about 12 seconds at 50 fps)
+#define PROFILER_HISTORY_SIZE 600
+
+#define NUM_PROFILE_PHASES 9
+#define NUM_PROFILE_COUNTERS 10
+
+enum profile_phase
+{
+    PROFPHASE_PROCESSACTIONS,
+    PROFPHASE_APPLYAI,
+    PROFPHASE_APPLYPHYSICS,
+    PROFPHASE_ENTITYDELETION,
+    PROFPHASE_PARTICLEEFFECTS,
+    PROFPHASE_UPDATEANIMATIONS,
+    PROFPHASE_RENDERTEXTURES,
+    // time the main thread waited for the render thread, and time the render
+    // thread spent drawing and presenting the previous frame (in parallel)
+    PROFPHASE_RENDERWAIT,
+    PROFPHASE_RENDERTHREAD
+};
+
+enum profile_counter
+{
+    PROFCOUNT_NPCS,
+    PROFCOUNT_PROPS,
+    PROFCOUNT_PARTICLES,
+    PROFCOUNT_WALLS,
+    PROFCOUNT_WALLRECTS,
+    PROFCOUNT_DELETIONS,
+    PROFCOUNT_LEVELHEAPALLOCS,
+    PROFCOUNT_SPRITESDRAWN,
+    PROFCOUNT_SPRITESCULLED,
+    PROFCOUNT_DRAWCALLS
+};
+
+struct profile_frame
+{
+    double phase_ms[NUM_PROFILE_PHASES];
+    int counters[NUM_PROFILE_COUNTERS];
+};
+
+struct profile_phase_stats
+{
+    double min_ms;
+    double mean_ms;
+    double p99_ms;
+};
+
+class frame_profiler
+{
+    public:
+        frame_profiler();
+        void reset();
+        void beginFrame();
+        void endFrame();
+        void beginPhase(profile_phase);
+        void endPhase(profile_phase);
+        void setPhaseTime(profile_phase, double);
+        void setCounter(profile_counter, int);
+        void toggleOverlay();
+        bool overlayVisible();
+        bool writeCSV(std::string);
+        int getNumFrames();
+        profile_frame getFrame(int);
+        profile_phase_stats getPhaseStats(profile_phase);
+        int getTotalFrames();
+        double getTotalPhaseTime(profile_phase);
+        int getPeakCounter(profile_counter);
+    private:
+        // ring buffer of the most recent frames
+        std::vector<profile_frame> history;
+        int next_frame;
+        int num_frames;
+        profile_frame current_frame;
+        Uint64 phase_start[NUM_PROFILE_PHASES];
+        bool overlay_visible;
+        // running totals since the last reset (not limited to the ring buffer)
+        int total_frames;
+        double total_phase_ms[NUM_PROFILE_PHASES];
+        int peak_counters[NUM_PROFILE_COUNTERS];
+        // statistics of the frames in the ring buffer, computed at most once per frame
+        profile_phase_stats phase_stats[NUM_PROFILE_PHASES];
+        bool phase_stats_valid;
+        std::vector<double> phase_times;
+        void computePhaseStats();
+};
+
+std::string getProfilePhaseName(profile_phase);
+std::string getProfileCounterName(profile_counter);
+std::string formatProfileTime(double);
+
+#endif
@@ -0,0 +1,399 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+#include "proppool.h"
+
+prop_pool::prop_pool()
+{
+}
+
+void prop_pool::init(int capacity)
+{
+    loc_x.assign(capacity,0.0);
+    loc_y.assign(capacity,0.0);
+    old_loc_x.assign(capacity,0.0);
+    old_loc_y.assign(capacity,0.0);
+    velocity_x.assign(capacity,0.0);
+    velocity_y.assign(capacity,0.0);
+    dim_x.assign(capacity,0.0);
+    dim_y.assign(capacity,0.0);
+    max_velocity_x.assign(capacity,0.0);
+    max_velocity_y.assign(capacity,0.0);
+    acceleration_x.assign(capacity,0.0);
+    velocity_decrement_x.assign(capacity,1.0);
+    stop_velocity_x.assign(capacity,0.0);
+    speed_up_factor.assign(capacity,1.0);
+    vertical_motion.assign(capacity,0);
+    phys_stat.assign(capacity,PHYSTYPE_FULL);
+    moved.assign(capacity,0);
+    batch_selected.assign(capacity,0);
+    live.assign(capacity,0);
+    destroy_upon_collision.assign(capacity,0);
+    mark_for_deletion.assign(capacity,0);
+    current_frame.assign(capacity,0);
+    num_frames.assign(capacity,1);
+    animation_speed.assign(capacity,1);
+    animation_speed_counter.assign(capacity,0);
+    is_animating.assign(capacity,0);
+    reset_frame_when_done.assign(capacity,1);
+    texture_index.assign(capacity,0);
+    texture_row.assign(capacity,0);
+    x_orientation.assign(capacity,SDL_FLIP_NONE);
+    spawn_order.reserve(capacity);
+    free_slots.reserve(capacity);
+    clear();
+}
+
+// Free every slot (the slot memory is kept)
+void prop_pool::clear()
+{
+    spawn_order.clear();
+    free_slots.clear();
+    std::fill(live.begin(),live.end(),0);
+    std::fill(moved.begin(),moved.end(),0);
+
+    // pushed in reverse so slots are handed out from 0 upward
+    for (int i = getCapacity() - 1; i >= 0; --i)
+        free_slots.push_back(i);
+}
+
+// Get a slot for a new prop of type "idef" at "loc" and return its slot index.
+// The slot is set up like a new dynamic_entity after setDynamicEntityFields.
+// The new prop is the last one in spawn order.
+int prop_pool::spawnProp(initial_dynamic_entity_fields idef, point loc)
+{
+    int slot = 0;
+
+    if (!free_slots.empty())
+    {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    }
+    else
+    {
+        int order_index = getRecycleIndex();
+        slot = spawn_order[order_index];
+        spawn_order.erase(spawn_order.begin() + order_index);
+    }
+
+    loc_x[slot] = loc.x();
+    loc_y[slot] = loc.y();
+    old_loc_x[slot] = old_loc_y[slot] = 0.0;
+    velocity_x[slot] = velocity_y[slot] = 0.0;
+    dim_x[slot] = idef.dimensions.x();
+    dim_y[slot] = idef.dimensions.y();
+    max_velocity_x[slot] = idef.max_velocity.x();
+    max_velocity_y[slot] = idef.max_velocity.y();
+    velocity_decrement_x[slot] = idef.horizontal_velocity_decrement;
+    stop_velocity_x[slot] = idef.horizontal_stop_velocity;
+    speed_up_factor[slot] = idef.speed_up_factor;
+    vertical_motion[slot] = 1;
+    phys_stat[slot] = PHYSTYPE_FULL;
+    moved[slot] = 0;
+    live[slot] = 1;
+    destroy_upon_collision[slot] = 0;
+    mark_for_deletion[slot] = 0;
+    current_frame[slot] = 0;
+    num_frames[slot] = idef.num_frames;
+    animation_speed[slot] = idef.animation_speed;
+    animation_speed_counter[slot] = 0;
+    is_animating[slot] = 0;
+    reset_frame_when_done[slot] = 1;
+    texture_index[slot] = idef.texture_index;
+    texture_row[slot] = 0;
+    x_orientation[slot] = SDL_FLIP_NONE;
+    setXDeltaNormal(slot,0.0);
+
+    spawn_order.push_back(slot);
+
+    return slot;
+}
+
+// Position in spawn_order of the prop to reuse when the pool is full:
+// the oldest one resting on the ground, else the oldest one.
+int prop_pool::getRecycleIndex()
+{
+    for (int i = 0; i < (int)spawn_order.size(); ++i)
+    {
+        if (isResting(spawn_order[i]))
+            return i;
+    }
+
+    return 0;
+}
+
+// Free the slots of all props marked for deletion (one pass, spawn order kept).
+// Returns the number of props removed.
+int prop_pool::removeMarkedProps()
+{
+    int num_kept = 0;
+
+    for (int i = 0; i < (int)spawn_order.size(); ++i)
+    {
+        if (mark_for_deletion[spawn_order[i]])
+        {
+            live[spawn_order[i]] = 0;
+            moved[spawn_order[i]] = 0;
+            free_slots.push_back(spawn_order[i]);
+        }
+        else
+        {
+            spawn_order[num_kept] = spawn_order[i];
+            num_kept++;
+        }
+    }
+
+    int num_removed = (int)spawn_order.size() - num_kept;
+
+    spawn_order.resize(num_kept);
+
+    return num_removed;
+}
+
+// number of live props
+int prop_pool::size()
+{
+    return (int)spawn_order.size();
+}
+
+int prop_pool::getCapacity()
+{
+    return (int)live.size();
+}
+
+// slot of the i'th live prop in spawn order (0 = oldest)
+int prop_pool::getSlot(int i)
+{
+    return spawn_order[i];
+}
+
+// Set the physics type of every live prop (props spawned later start with PHYSTYPE_FULL)
+void prop_pool::setPhysicsStatus(physics_type pst)
+{
+    for (int i = 0; i < (int)spawn_order.size(); ++i)
+        phys_stat[spawn_order[i]] = pst;
+}
+
+// Horizontal acceleration, horizontal resistance, gravity and movement for every
+// live prop that isn't resting. Props are integrated in one batch per physics type
+// (see physkernel.h); free slots are left alone.
+// Collisions are handled afterwards by the caller, for the slots where hasMoved is true.
+void prop_pool::integrateProps()
+{
+    const physics_type batch_types[3] = {PHYSTYPE_FULL, PHYSTYPE_NO_HORIZ_ACC, PHYSTYPE_NO_HORIZ_OR_GRAV_ACC};
+    int capacity = getCapacity();
+
+    if (capacity == 0)
+        return;
+
+    physics_batch batch;
+    batch.loc_x = &loc_x[0];
+    batch.loc_y = &loc_y[0];
+    batch.old_loc_x = &old_loc_x[0];
+    batch.old_loc_y = &old_loc_y[0];
+    batch.velocity_x = &velocity_x[0];
+    batch.velocity_y = &velocity_y[0];
+    batch.max_velocity_x = &max_velocity_x[0];
+    batch.max_velocity_y = &max_velocity_y[0];
+    batch.acceleration_x = &acceleration_x[0];
+    batch.velocity_decrement_x = &velocity_decrement_x[0];
+    batch.stop_velocity_x = &stop_velocity_x[0];
+    batch.selected = &batch_selected[0];
+    batch.count = capacity;
+
+    std::fill(moved.begin(),moved.end(),0);
+
+    for (int t = 0; t < 3; ++t)
+    {
+        int num_selected = 0;
+
+        for (int i = 0; i < capacity; ++i)
+        {
+            batch_selected[i] = (char)(live[i] && phys_stat[i] == batch_types[t] && !isResting(i));
+            num_selected += batch_selected[i];
+        }
+
+        if (num_selected == 0)
+            continue;
+
+        integratePhysicsBatch(batch,batch_types[t]);
+
+        for (int i = 0; i < capacity; ++i)
+            moved[i] |= batch_selected[i];
+    }
+}
+
+// Same as dynamic_entity::restrictLoc: push the prop out of blocker (minp,maxp)
+// on the side it came from
+void prop_pool::restrictProp(int slot, point minp, point maxp)
+{
+    if (old_loc_y[slot] >= maxp.y()) {
+        loc_y[slot] = maxp.y() + 1.0;
+        velocity_y[slot] = 2.6;
+    }
+    else if (old_loc_y[slot] <= minp.y() - dim_y[slot]) {
+        vertical_motion[slot] = 0;
+        loc_y[slot] = minp.y() - dim_y[slot];
+        velocity_y[slot] = 0.0;
+    }
+    else if (old_loc_x[slot] >= maxp.x()) {
+        loc_x[slot] = maxp.x() + 1.0;
+        velocity_x[slot] = 0.5;
+    }
+    else if (old_loc_x[slot] <= minp.x() - dim_x[slot]) {
+        loc_x[slot] = minp.x() - dim_x[slot] - 1.0;
+        velocity_x[slot] = -0.5;
+    }
+}
+
+// Same as dynamic_entity::animate(0,num_frames-1) for every live prop with full physics
+void prop_pool::animateProps()
+{
+    for (int i = 0; i < (int)spawn_order.size(); ++i)
+    {
+        int slot = spawn_order[i];
+
+        if (is_animating[slot] && phys_stat[slot] == PHYSTYPE_FULL)
+        {
+            animation_speed_counter[slot]++;
+            if (animation_speed_counter[slot] % animation_speed[slot] == 0)
+                current_frame[slot]++;
+            if (current_frame[slot] > num_frames[slot] - 1 || current_frame[slot] < 0)
+            {
+                current_frame[slot]--;
+                setAnimationStatus(slot,false);
+            }
+        }
+    }
+}
+
+void prop_pool::setVelocity(int slot, point vel)
+{
+    velocity_x[slot] = vel.x();
+    velocity_y[slot] = vel.y();
+    limitVelocity(slot);
+}
+
+void prop_pool::limitVelocity(int slot)
+{
+    velocity_x[slot] = std::min(std::max(velocity_x[slot],-max_velocity_x[slot]),max_velocity_x[slot]);
+    velocity_y[slot] = std::min(std::max(velocity_y[slot],-max_velocity_y[slot]),max_velocity_y[slot]);
+}
+
+void prop_pool::setXDeltaNormal(int slot, double xdn)
+{
+    acceleration_x[slot] = (max_velocity_x[slot]/speed_up_factor[slot])*xdn;
+}
+
+void prop_pool::setXOrientation(int slot, SDL_RendererFlip srf)
+{
+    x_orientation[slot] = srf;
+}
+
+void prop_pool::setAnimationSpeed(int slot, int spd)
+{
+    animation_speed[slot] = spd;
+}
+
+void prop_pool::setAnimationStatus(int slot, bool f)
+{
+    is_animating[slot] = f;
+    if (!f)
+    {
+        animation_speed_counter[slot] = 0;
+        if (reset_frame_when_done[slot])
+            current_frame[slot] = 0;
+    }
+}
+
+void prop_pool::setResetFrameFlag(int slot, bool f)
+{
+    reset_frame_when_done[slot] = f;
+}
+
+void prop_pool::setDestructableUponCollision(int slot, bool flag)
+{
+    destroy_upon_collision[slot] = flag;
+}
+
+void prop_pool::setTextureRow(int slot, int row)
+{
+    texture_row[slot] = row;
+}
+
+void prop_pool::setMarkForDeletion(int slot)
+{
+    mark_for_deletion[slot] = 1;
+}
+
+// true if the last integrateProps call moved this prop
+bool prop_pool::hasMoved(int slot)
+{
+    return moved[slot] != 0;
+}
+
+bool prop_pool::destroyUponCollision(int slot)
+{
+    return destroy_upon_collision[slot] != 0;
+}
+
+// resting props are skipped by integrateProps
+bool prop_pool::isResting(int slot)
+{
+    return velocity_y[slot] == 0.0 && !vertical_motion[slot];
+}
+
+point prop_pool::getLoc(int slot)
+{
+    return point(loc_x[slot],loc_y[slot]);
+}
+
+point prop_pool::getOldLoc(int slot)
+{
+    return point(old_loc_x[slot],old_loc_y[slot]);
+}
+
+point prop_pool::getMaxLoc(int slot)
+{
+    return getLoc(slot) + getDim(slot);
+}
+
+point prop_pool::getCenter(int slot)
+{
+    return getMidpoint(getLoc(slot),getMaxLoc(slot));
+}
+
+point prop_pool::getDim(int slot)
+{
+    return point(dim_x[slot],dim_y[slot]);
+}
+
+point prop_pool::getVelocity(int slot)
+{
+    return point(velocity_x[slot],velocity_y[slot]);
+}
+
+int prop_pool::getAnimationSpeed(int slot)
+{
+    return animation_speed[slot];
+}
+
+int prop_pool::getCurrentFrame(int slot)
+{
+    return current_frame[slot];
+}
+
+int prop_pool::getTextureIndex(int slot)
+{
+    return texture_index[slot];
+}
+
+int prop_pool::getTextureRow(int slot)
+{
+    return texture_row[slot];
+}
+
+SDL_RendererFlip prop_pool::getXOrientation(int slot)
+{
+    return x_orientation[slot];
+}
@@ -0,0 +1,101 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+#ifndef PROPPOOL_H_
+#define PROPPOOL_H_
+
+#include "globals.h"
+#include "entity.h"
+#include "physkernel.h"
+
+// Fixed capacity storage for cosmetic props (blood and gibs).
+// Slots are allocated once; freed slots go on a free list and are reused.
+// When every slot is taken, the oldest prop that has come to rest is recycled
+// (or the oldest prop if none has), so the number of props never exceeds the capacity.
+// Live props are visited in the order they were spawned.
+//
+// Props are stored as structure-of-arrays (one array per field, indexed by slot)
+// so integrateProps can update every slot with the batch physics kernels.
+// It gives the same results as applyPhysicsForDynamicEntity on a dynamic_entity.
+class prop_pool
+{
+    public:
+        prop_pool();
+        void init(int);
+        void clear();
+        int spawnProp(initial_dynamic_entity_fields, point);
+        int removeMarkedProps();
+        int size();
+        int getCapacity();
+        int getSlot(int);
+        void setPhysicsStatus(physics_type);
+        void integrateProps();
+        void restrictProp(int, point, point);
+        void animateProps();
+        void setVelocity(int, point);
+        void setXDeltaNormal(int, double);
+        void setXOrientation(int, SDL_RendererFlip);
+        void setAnimationSpeed(int, int);
+        void setAnimationStatus(int, bool);
+        void setResetFrameFlag(int, bool);
+        void setDestructableUponCollision(int, bool);
+        void setTextureRow(int, int);
+        void setMarkForDeletion(int);
+        bool hasMoved(int);
+        bool destroyUponCollision(int);
+        point getLoc(int);
+        point getOldLoc(int);
+        point getMaxLoc(int);
+        point getCenter(int);
+        point getDim(int);
+        point getVelocity(int);
+        int getAnimationSpeed(int);
+        int getCurrentFrame(int);
+        int getTextureIndex(int);
+        int getTextureRow(int);
+        SDL_RendererFlip getXOrientation(int);
+    private:
+        int getRecycleIndex();
+        bool isResting(int);
+        void limitVelocity(int);
+        std::vector<int> free_slots;
+        // slot indices of live props, oldest first
+        std::vector<int> spawn_order;
+        // physics state (one entry per slot)
+        std::vector<double> loc_x;
+        std::vector<double> loc_y;
+        std::vector<double> old_loc_x;
+        std::vector<double> old_loc_y;
+        std::vector<double> velocity_x;
+        std::vector<double> velocity_y;
+        std::vector<double> dim_x;
+        std::vector<double> dim_y;
+        std::vector<double> max_velocity_x;
+        std::vector<double> max_velocity_y;
+        // per tick horizontal acceleration (max x velocity / speed up factor * x delta normal)
+        std::vector<double> acceleration_x;
+        std::vector<double> velocity_decrement_x;
+        std::vector<double> stop_velocity_x;
+        std::vector<double> speed_up_factor;
+        std::vector<char> vertical_motion;
+        std::vector<physics_type> phys_stat;
+        // set by integrateProps for the slots it moved
+        std::vector<char> moved;
+        // scratch select flags for the physics kernels
+        std::vector<char> batch_selected;
+        std::vector<char> live;
+        std::vector<char> destroy_upon_collision;
+        std::vector<char> mark_for_deletion;
+        // animation and drawing
+        std::vector<int> current_frame;
+        std::vector<int> num_frames;
+        std::vector<int> animation_speed;
+        std::vector<int> animation_speed_counter;
+        std::vector<char> is_animating;
+        std::vector<char> reset_frame_when_done;
+        std::vector<int> texture_index;
+        std::vector<int> texture_row;
+        std::vector<SDL_RendererFlip> x_orientation;
+};
+
+#endif
@@ -3,6 +3,13 @@
 
 #include "rng.h"
 
+static std::mt19937 *random_number_generator = NULL;
+
+void setRandomNumberGenerator(std::mt19937 *engine)
+{
+    random_number_generator = engine;
+}
+
 bool roll(int sides)
 {
     return randInt(0,sides-1) == 0;
@@ -19,7 +26,7 @@ int randInt(int low, int high)
         return high;
 
     std::uniform_int_distribution<int> dist(low,high);
-    return dist(random_number_generator);
+    return dist(*random_number_generator);
 }
 
 int randZero(int num)
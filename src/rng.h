@@ -7,7 +7,9 @@
 #include <random>
 #include <time.h>
 
-static std::mt19937 random_number_generator(time(0));
+// All random numbers come from one engine owned by Game (see Game::setSeed),
+// so a given seed always reproduces the same game.
+void setRandomNumberGenerator(std::mt19937 *);
 
 bool roll(int);
 bool rollPerc(int);
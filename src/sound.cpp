@@ -8,6 +8,7 @@ snd_engine::snd_engine()
     for (int i = 0; i < NUM_TOTAL_SOUNDS; ++i)
     {
         sound_effects[i] = NULL;
+        sound_jobs[i] = -1;
     }
 }
 
@@ -20,26 +21,73 @@ snd_engine::~snd_engine()
 bool snd_engine::initMixer()
 {
     //Initialize SDL_mixer
-    if( Mix_OpenAudio( 44100, MIX_DEFAULT_FORMAT, 2, 2048 ) < 0 )
+    if( Mix_OpenAudio( MIXER_FREQUENCY, MIXER_FORMAT, MIXER_CHANNELS, 2048 ) < 0 )
     {
         return false;
     }
 
-    // initialize all sounds
+    Mix_Volume(-1,36);
+
+    return true;
+}
+
+// Add a decoding job for every sound (after initMixer, since they are converted to its format)
+void snd_engine::queueSoundDecoding(asset_loader *loader)
+{
     for (int i = 0; i < NUM_TOTAL_SOUNDS; ++i)
     {
-        sound_effects[i] = Mix_LoadWAV(&("Debug\\sounds\\" + sound_file_names[i])[0]);
+        sound_jobs[i] = loader->addJob(ASSETTYPE_SOUND,"Debug\\sounds\\" + sound_file_names[i]);
+    }
+}
+
+// Take the decoded sounds (call waitForAll first). Until then no sound is played.
+bool snd_engine::loadSounds(asset_loader *loader)
+{
+    for (int i = 0; i < NUM_TOTAL_SOUNDS; ++i)
+    {
+        sound_effects[i] = (Mix_Chunk *)loader->takeResult(sound_jobs[i]);
 
         if (sound_effects[i] == NULL)
+        {
+            std::cout << "Failed to load " << sound_file_names[i] << "\n";
             return false;
+        }
     }
 
-    Mix_Volume(-1,36);
+    return true;
+}
+
+// Make every sound from the PCM samples in an asset bundle (the chunks use the mapped
+// samples, nothing is decoded or copied). Returns false, loading nothing, if the
+// mixer's format differs from the bundle's or the bundle lacks a sound.
+bool snd_engine::loadSoundsFromBundle(asset_bundle *bundle)
+{
+    int frequency = 0;
+    Uint16 format = 0;
+    int channels = 0;
+
+    if (Mix_QuerySpec(&frequency,&format,&channels) == 0 || !bundle->hasSoundFormat(frequency,format,channels))
+        return false;
+
+    for (int i = 0; i < NUM_TOTAL_SOUNDS; ++i)
+    {
+        const bundle_entry *entry = bundle->findEntry(sound_file_names[i],BUNDLEENTRY_SOUND);
+
+        if (entry != NULL)
+            sound_effects[i] = Mix_QuickLoad_RAW((Uint8 *)bundle->getEntryData(entry),(Uint32)entry->size);
+
+        if (sound_effects[i] == NULL)
+        {
+            std::cout << sound_file_names[i] << " is not in the asset bundle\n";
+            freeSoundEffects();
+            return false;
+        }
+    }
 
     return true;
 }
 
-void snd_engine::freeMixer()
+void snd_engine::freeSoundEffects()
 {
     for (int i = 0; i < NUM_TOTAL_SOUNDS; ++i)
     {
@@ -49,12 +97,21 @@ void snd_engine::freeMixer()
             sound_effects[i] = NULL;
         }
     }
+}
+
+void snd_engine::freeMixer()
+{
+    freeSoundEffects();
 
     Mix_Quit();
 }
 
 void snd_engine::playSoundEffect(Mix_Chunk *seff)
 {
+    // sounds are never loaded when running headless (nor before they are decoded)
+    if (seff == NULL)
+        return;
+
     Mix_PlayChannel( -1, seff, 0 );
 }
 
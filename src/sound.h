@@ -5,9 +5,16 @@
 #define SOUND_H_
 
 #include "globals.h"
+#include "loader.h"
+#include "bundle.h"
 
 #define NUM_TOTAL_SOUNDS 29
 
+// output format of the mixer (and of the sounds in an asset bundle)
+#define MIXER_FREQUENCY 44100
+#define MIXER_FORMAT MIX_DEFAULT_FORMAT
+#define MIXER_CHANNELS 2
+
 enum sound_type
 {
     SOUNDTYPE_COIN,
@@ -80,12 +87,18 @@ public:
     snd_engine();
     ~snd_engine();
     bool initMixer();
+    void queueSoundDecoding(asset_loader *);
+    bool loadSounds(asset_loader *);
+    bool loadSoundsFromBundle(asset_bundle *);
+    void freeSoundEffects();
     void freeMixer();
     void playSoundEffect(Mix_Chunk *);
     Mix_Chunk* getSoundEffect(int);
 
 private:
     Mix_Chunk* sound_effects[NUM_TOTAL_SOUNDS];
+    // decoding job of each sound
+    int sound_jobs[NUM_TOTAL_SOUNDS];
 };
 
 #endif
@@ -0,0 +1,210 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+#include "spatial.h"
+
+tile_grid::tile_grid()
+{
+    cell_size = SMALL_BLOCK_DIM;
+    width = height = 0;
+}
+
+// map_size: level size in pixels
+void tile_grid::init(point map_size, double csize)
+{
+    clear();
+    cell_size = csize;
+    width = std::max(1,(int)std::ceil(map_size.x() / cell_size) + 1);
+    height = std::max(1,(int)std::ceil(map_size.y() / cell_size) + 1);
+    // never shrinks, so a smaller level reuses the cells of a bigger one
+    if ((int)cells.size() < width * height)
+        cells.resize(width * height);
+    // walls are block aligned, so a cell only ever holds a handful of entries;
+    // reserving them up front means rebuilding the grid does not allocate
+    for (int i = 0; i < (int)cells.size(); ++i)
+         cells[i].reserve(TILE_GRID_CELL_RESERVE);
+}
+
+// Empty the grid but keep its storage, so the next level reuses it
+void tile_grid::clear()
+{
+    for (int i = 0; i < (int)cells.size(); ++i)
+         cells[i].clear();
+    entry_ranges.clear();
+    width = height = 0;
+}
+
+// Total number of entries the grid can hold without allocating
+int tile_grid::getCapacity()
+{
+    int total = (int)cells.capacity() + (int)entry_ranges.capacity();
+    for (int i = 0; i < (int)cells.size(); ++i)
+         total += (int)cells[i].capacity();
+    return total;
+}
+
+// Cells touched by the box minp..maxp (boundaries included).
+// Anything off the map is clamped to the border cells.
+tile_grid_range tile_grid::getCellRange(point minp, point maxp)
+{
+    tile_grid_range range;
+    range.min_x = std::min(width - 1,std::max(0,(int)std::floor(minp.x() / cell_size)));
+    range.min_y = std::min(height - 1,std::max(0,(int)std::floor(minp.y() / cell_size)));
+    range.max_x = std::min(width - 1,std::max(0,(int)std::floor(maxp.x() / cell_size)));
+    range.max_y = std::min(height - 1,std::max(0,(int)std::floor(maxp.y() / cell_size)));
+    return range;
+}
+
+void tile_grid::addToCells(int id, tile_grid_range range)
+{
+    for (int y = range.min_y; y <= range.max_y; ++y)
+    for (int x = range.min_x; x <= range.max_x; ++x)
+        cells[y * width + x].push_back(id);
+}
+
+void tile_grid::removeFromCells(int id, tile_grid_range range)
+{
+    for (int y = range.min_y; y <= range.max_y; ++y)
+    for (int x = range.min_x; x <= range.max_x; ++x)
+    {
+        std::vector<int> &cell = cells[y * width + x];
+        cell.erase(std::remove(cell.begin(),cell.end(),id),cell.end());
+    }
+}
+
+// Add entry "id" (index into the caller's vector) with bounding box minp..maxp
+void tile_grid::insert(int id, point minp, point maxp)
+{
+    if ((int)entry_ranges.size() <= id)
+        entry_ranges.resize(id + 1);
+
+    entry_ranges[id] = getCellRange(minp,maxp);
+    addToCells(id,entry_ranges[id]);
+}
+
+// Entry "id" has a new bounding box (i.e. a door opening or closing).
+// Cells are only touched when the covered cell range changes.
+void tile_grid::move(int id, point minp, point maxp)
+{
+    tile_grid_range range = getCellRange(minp,maxp);
+    tile_grid_range &old_range = entry_ranges[id];
+
+    if (range.min_x == old_range.min_x && range.min_y == old_range.min_y &&
+        range.max_x == old_range.max_x && range.max_y == old_range.max_y)
+        return;
+
+    removeFromCells(id,old_range);
+    old_range = range;
+    addToCells(id,range);
+}
+
+// Fill "result" with every entry in the cells touched by minp..maxp,
+// sorted by id and without duplicates (so callers can keep processing in index order).
+void tile_grid::query(point minp, point maxp, std::vector<int> &result)
+{
+    result.clear();
+
+    if (cells.empty())
+        return;
+
+    tile_grid_range range = getCellRange(minp,maxp);
+
+    for (int y = range.min_y; y <= range.max_y; ++y)
+    for (int x = range.min_x; x <= range.max_x; ++x)
+    {
+        std::vector<int> &cell = cells[y * width + x];
+        result.insert(result.end(),cell.begin(),cell.end());
+    }
+
+    std::sort(result.begin(),result.end());
+    result.erase(std::unique(result.begin(),result.end()),result.end());
+}
+
+spatial_hash::spatial_hash()
+{
+    cell_size = SPATIAL_HASH_CELL_DIM;
+    buckets.resize(SPATIAL_HASH_BUCKETS);
+}
+
+// Empty every bucket (keeping the memory for the next rebuild)
+void spatial_hash::clear()
+{
+    for (int i = 0; i < (int)used_buckets.size(); ++i)
+        buckets[used_buckets[i]].clear();
+
+    used_buckets.clear();
+}
+
+tile_grid_range spatial_hash::getCellRange(point minp, point maxp)
+{
+    tile_grid_range range;
+    range.min_x = (int)std::floor(minp.x() / cell_size);
+    range.min_y = (int)std::floor(minp.y() / cell_size);
+    range.max_x = (int)std::floor(maxp.x() / cell_size);
+    range.max_y = (int)std::floor(maxp.y() / cell_size);
+    return range;
+}
+
+int spatial_hash::getBucket(int x, int y)
+{
+    return (int)(((unsigned int)x * 73856093U) ^ ((unsigned int)y * 19349663U)) & (SPATIAL_HASH_BUCKETS - 1);
+}
+
+// Boxes spanning more cells than there are buckets just use every bucket
+bool spatial_hash::coversAllBuckets(tile_grid_range range)
+{
+    return (double)(range.max_x - range.min_x + 1) * (double)(range.max_y - range.min_y + 1) >= (double)SPATIAL_HASH_BUCKETS;
+}
+
+void spatial_hash::insert(int id, point minp, point maxp)
+{
+    tile_grid_range range = getCellRange(minp,maxp);
+
+    if (coversAllBuckets(range))
+    {
+        for (int i = 0; i < SPATIAL_HASH_BUCKETS; ++i)
+        {
+            if (buckets[i].empty())
+                used_buckets.push_back(i);
+            buckets[i].push_back(id);
+        }
+        return;
+    }
+
+    for (int y = range.min_y; y <= range.max_y; ++y)
+    for (int x = range.min_x; x <= range.max_x; ++x)
+    {
+        std::vector<int> &bucket = buckets[getBucket(x,y)];
+        if (bucket.empty())
+            used_buckets.push_back(getBucket(x,y));
+        // an entry spanning two cells of the same bucket is only stored once
+        if (bucket.empty() || bucket.back() != id)
+            bucket.push_back(id);
+    }
+}
+
+// Same as tile_grid::query: candidates sorted by id, no duplicates
+void spatial_hash::query(point minp, point maxp, std::vector<int> &result)
+{
+    result.clear();
+
+    tile_grid_range range = getCellRange(minp,maxp);
+
+    if (coversAllBuckets(range))
+    {
+        for (int i = 0; i < (int)used_buckets.size(); ++i)
+            result.insert(result.end(),buckets[used_buckets[i]].begin(),buckets[used_buckets[i]].end());
+    }
+    else
+    {
+        for (int y = range.min_y; y <= range.max_y; ++y)
+        for (int x = range.min_x; x <= range.max_x; ++x)
+        {
+            std::vector<int> &bucket = buckets[getBucket(x,y)];
+            result.insert(result.end(),bucket.begin(),bucket.end());
+        }
+    }
+
+    std::sort(result.begin(),result.end());
+    result.erase(std::unique(result.begin(),result.end()),result.end());
+}
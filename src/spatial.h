@@ -0,0 +1,71 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+#ifndef SPATIAL_H_
+#define SPATIAL_H_
+
+#include "globals.h"
+#include "point.h"
+
+// cell range covered by one grid entry (inclusive)
+struct tile_grid_range
+{
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+};
+
+// entries reserved per cell when the grid is initialized
+#define TILE_GRID_CELL_RESERVE 8
+
+// Uniform grid over the level map (one cell per SMALL_BLOCK_DIM tile).
+// Every entry (a wall or door index) is stored in each cell its bounding box touches,
+// so a query only has to look at the cells overlapping the query box.
+class tile_grid
+{
+    public:
+        tile_grid();
+        void init(point, double);
+        void clear();
+        void insert(int, point, point);
+        void move(int, point, point);
+        void query(point, point, std::vector<int> &);
+        int getCapacity();
+    private:
+        tile_grid_range getCellRange(point, point);
+        void addToCells(int, tile_grid_range);
+        void removeFromCells(int, tile_grid_range);
+        double cell_size;
+        int width;
+        int height;
+        std::vector<std::vector<int>> cells;
+        std::vector<tile_grid_range> entry_ranges;
+};
+
+// number of buckets in a spatial_hash (power of 2)
+#define SPATIAL_HASH_BUCKETS 1024
+#define SPATIAL_HASH_CELL_DIM 80.0
+
+// Hashed grid for things that move every tick (npcs, items, powerups).
+// Unlike tile_grid it is not bound to the map, so entities flying off the map still work.
+// Two cells can share a bucket, which only adds extra candidates.
+class spatial_hash
+{
+    public:
+        spatial_hash();
+        void clear();
+        void insert(int, point, point);
+        void query(point, point, std::vector<int> &);
+        int getCapacity();
+    private:
+        tile_grid_range getCellRange(point, point);
+        int getBucket(int, int);
+        bool coversAllBuckets(tile_grid_range);
+        double cell_size;
+        std::vector<std::vector<int>> buckets;
+        // buckets that are not empty (so clear doesn't visit all of them)
+        std::vector<int> used_buckets;
+};
+
+#endif
@@ -0,0 +1,128 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+// Stress scenario benchmark.
+// Build it from every file in src/ except main.cpp, plus this file (with src/ on the include path).
+// Each scenario prints one JSON line so results of different commits can be compared.
+//
+// usage: benchmark [--ticks <n>] [--seed <n>] [scenario ...]
+// scenarios: level10_full gunfire gibstorm mapgen (default: all of them)
+
+#include "game.h"
+
+#define NUM_BENCHMARK_SCENARIOS 4
+#define MAPGEN_SWEEP_LEVELS 100
+
+static const std::string benchmark_scenario_names[NUM_BENCHMARK_SCENARIOS] =
+{
+    "level10_full",
+    "gunfire",
+    "gibstorm",
+    "mapgen"
+};
+
+// Print the totals gathered by the profiler as one JSON object
+void printBenchmarkResult(std::string name, unsigned int seed, frame_profiler *prof, double seconds)
+{
+    int ticks = prof->getTotalFrames();
+
+    std::cout << "{\"scenario\":\"" << name << "\",\"seed\":" << seed << ",\"ticks\":" << ticks << ",\"seconds\":" << seconds;
+    std::cout << ",\"ticks_per_sec\":" << (seconds > 0.0 ? (double)ticks / seconds : 0.0);
+
+    std::cout << ",\"ns_per_phase\":{";
+    for (int i = 0; i < NUM_PROFILE_PHASES; ++i)
+    {
+        double ns = (ticks > 0 ? prof->getTotalPhaseTime((profile_phase)i) * 1000000.0 / (double)ticks : 0.0);
+        std::cout << (i > 0 ? "," : "") << "\"" << getProfilePhaseName((profile_phase)i) << "\":" << (long long)ns;
+    }
+    std::cout << "}";
+
+    std::cout << ",\"peak\":{";
+    for (int i = 0; i < NUM_PROFILE_COUNTERS; ++i)
+        std::cout << (i > 0 ? "," : "") << "\"" << getProfileCounterName((profile_counter)i) << "\":" << prof->getPeakCounter((profile_counter)i);
+    std::cout << "}}\n";
+}
+
+// Run scenario "name" and print its result. Returns false for an unknown scenario.
+bool runBenchmarkScenario(Game *game, std::string name, int num_ticks, unsigned int seed)
+{
+    game->setSeed(seed);
+
+    Uint64 start_counter = SDL_GetPerformanceCounter();
+
+    if (name == "level10_full")
+    {
+        // level 10 map filled to the maximum number of npcs, player idle
+        game->initBenchmarkLevel(10);
+        game->runBenchmarkTicks(num_ticks,false);
+    }
+    else if (name == "gunfire")
+    {
+        // player spams the chaingun, then the shotgun (mobFireWeaponProjectile every tick)
+        game->initBenchmarkLevel(10);
+        game->equipPlayerWeapon(ITEMTYPE_CHAINGUN);
+        game->runBenchmarkTicks(num_ticks/2,true);
+        game->equipPlayerWeapon(ITEMTYPE_SHOTGUN);
+        game->runBenchmarkTicks(num_ticks - num_ticks/2,true);
+    }
+    else if (name == "gibstorm")
+    {
+        // flamethrower and rocket launcher on a full level (lots of particles and gibs)
+        game->initBenchmarkLevel(10);
+        game->equipPlayerWeapon(ITEMTYPE_FLAMETHROWER);
+        game->runBenchmarkTicks(num_ticks/2,true);
+        game->equipPlayerWeapon(ITEMTYPE_ROCKETLAUNCHER);
+        game->runBenchmarkTicks(num_ticks - num_ticks/2,true);
+    }
+    else if (name == "mapgen")
+    {
+        // generateMap for levels 1 to 100 (one tick per level)
+        game->runMapGenerationSweep(MAPGEN_SWEEP_LEVELS);
+    }
+    else
+    {
+        return false;
+    }
+
+    double seconds = (double)(SDL_GetPerformanceCounter() - start_counter) / (double)SDL_GetPerformanceFrequency();
+
+    printBenchmarkResult(name,seed,game->getProfiler(),seconds);
+
+    game->cleanupLevelData();
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int num_ticks = 3000;
+    unsigned int seed = 1;
+    std::vector<std::string> scenarios;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--ticks" && i + 1 < argc)
+            num_ticks = atoi(argv[++i]);
+        else if (std::string(argv[i]) == "--seed" && i + 1 < argc)
+            seed = (unsigned int)strtoul(argv[++i],NULL,10);
+        else
+            scenarios.push_back(argv[i]);
+    }
+
+    if (scenarios.empty())
+        scenarios.assign(benchmark_scenario_names,benchmark_scenario_names + NUM_BENCHMARK_SCENARIOS);
+
+    // No window, renderer or mixer is created, so nothing is drawn and no sounds are played
+    Game game;
+
+    for (int i = 0; i < (int)scenarios.size(); ++i)
+    {
+        if (!runBenchmarkScenario(&game,scenarios[i],num_ticks,seed))
+        {
+            std::cout << "Unknown scenario: " << scenarios[i] << "\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
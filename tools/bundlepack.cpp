@@ -0,0 +1,187 @@
+// Copyright Eric Wolfson 2016-2017
+// See LICENSE.txt (GPLv3)
+
+// Asset bundle packer (see src/bundle.h for the format).
+// Build it from this file alone (with src/ on the include path), linked with SDL2 and SDL2_image.
+// Decodes every file in texture_file_names (plus the font) and sound_file_names once, so
+// the game can map the bundle instead of decoding PNG and WAV files on every launch.
+//
+// usage: bundlepack <textures dir> <sounds dir> <bundle file>
+// e.g.   bundlepack textures sounds Debug/assets.bundle
+
+#include "graphics.h"
+#include "sound.h"
+
+struct packed_asset
+{
+    bundle_entry entry;
+    std::vector<Uint8> data;
+};
+
+// RGBA32 pixels of a PNG, row after row with no padding
+bool packImage(std::string file_name, packed_asset *asset)
+{
+    SDL_Surface *file_image = IMG_Load(file_name.c_str());
+    if (file_image == NULL)
+        return false;
+
+    SDL_Surface *image = SDL_ConvertSurfaceFormat(file_image,SDL_PIXELFORMAT_RGBA32,0);
+    SDL_FreeSurface(file_image);
+    if (image == NULL)
+        return false;
+
+    asset->entry.type = BUNDLEENTRY_IMAGE;
+    asset->entry.width = (Uint32)image->w;
+    asset->entry.height = (Uint32)image->h;
+    asset->data.resize((size_t)image->w * image->h * 4);
+
+    for (int y = 0; y < image->h; ++y)
+        memcpy(&asset->data[(size_t)y * image->w * 4],(Uint8 *)image->pixels + (size_t)y * image->pitch,(size_t)image->w * 4);
+
+    SDL_FreeSurface(image);
+    return true;
+}
+
+// PCM samples of a WAV, converted to the mixer's output format
+bool packSound(std::string file_name, packed_asset *asset)
+{
+    SDL_AudioSpec spec;
+    Uint8 *samples = NULL;
+    Uint32 length = 0;
+
+    if (SDL_LoadWAV(file_name.c_str(),&spec,&samples,&length) == NULL)
+        return false;
+
+    SDL_AudioCVT cvt;
+    if (SDL_BuildAudioCVT(&cvt,spec.format,spec.channels,spec.freq,MIXER_FORMAT,MIXER_CHANNELS,MIXER_FREQUENCY) < 0)
+    {
+        SDL_FreeWAV(samples);
+        return false;
+    }
+
+    asset->entry.type = BUNDLEENTRY_SOUND;
+    asset->entry.width = asset->entry.height = 0;
+
+    if (cvt.needed)
+    {
+        cvt.len = (int)length;
+        cvt.buf = (Uint8 *)SDL_malloc((size_t)length * cvt.len_mult);
+        if (cvt.buf == NULL)
+        {
+            SDL_FreeWAV(samples);
+            return false;
+        }
+        memcpy(cvt.buf,samples,length);
+        bool converted = (SDL_ConvertAudio(&cvt) == 0);
+        if (converted)
+            asset->data.assign(cvt.buf,cvt.buf + cvt.len_cvt);
+        SDL_free(cvt.buf);
+        SDL_FreeWAV(samples);
+        return converted;
+    }
+
+    asset->data.assign(samples,samples + length);
+    SDL_FreeWAV(samples);
+    return true;
+}
+
+// Pack file "name" from directory "dir" (each name only once)
+bool addAsset(std::vector<packed_asset> *assets, std::string dir, std::string name, bundle_entry_type type)
+{
+    for (int i = 0; i < (int)assets->size(); ++i)
+    {
+        if ((*assets)[i].entry.type == (Uint32)type && name == (*assets)[i].entry.name)
+            return true;
+    }
+
+    if (name.size() >= BUNDLE_NAME_LENGTH)
+    {
+        std::cout << "Name too long for the bundle index: " << name << "\n";
+        return false;
+    }
+
+    packed_asset asset;
+    memset(&asset.entry,0,sizeof(bundle_entry));
+    strcpy(asset.entry.name,name.c_str());
+
+    bool packed = (type == BUNDLEENTRY_IMAGE ? packImage(dir + "/" + name,&asset) : packSound(dir + "/" + name,&asset));
+    if (!packed)
+    {
+        std::cout << "Failed to load " << dir << "/" << name << ": " << SDL_GetError() << "\n";
+        return false;
+    }
+
+    asset.entry.size = (Uint64)asset.data.size();
+    assets->push_back(asset);
+    return true;
+}
+
+bool writeBundle(std::string file_name, std::vector<packed_asset> *assets)
+{
+    std::ofstream bundle_file(file_name.c_str(),std::ios::out | std::ios::binary);
+    if (!bundle_file.is_open())
+        return false;
+
+    bundle_header header;
+    memcpy(header.magic,BUNDLE_MAGIC,8);
+    header.version = BUNDLE_VERSION;
+    header.num_entries = (Uint32)assets->size();
+    header.sound_frequency = MIXER_FREQUENCY;
+    header.sound_format = MIXER_FORMAT;
+    header.sound_channels = MIXER_CHANNELS;
+
+    // data starts after the index, each entry on an alignment boundary
+    Uint64 offset = sizeof(bundle_header) + sizeof(bundle_entry) * assets->size();
+    for (int i = 0; i < (int)assets->size(); ++i)
+    {
+        offset = (offset + BUNDLE_ALIGNMENT - 1) / BUNDLE_ALIGNMENT * BUNDLE_ALIGNMENT;
+        (*assets)[i].entry.offset = offset;
+        offset += (*assets)[i].entry.size;
+    }
+
+    bundle_file.write((const char *)&header,sizeof(bundle_header));
+    for (int i = 0; i < (int)assets->size(); ++i)
+        bundle_file.write((const char *)&(*assets)[i].entry,sizeof(bundle_entry));
+
+    Uint64 position = sizeof(bundle_header) + sizeof(bundle_entry) * assets->size();
+    const char padding[BUNDLE_ALIGNMENT] = {0};
+    for (int i = 0; i < (int)assets->size(); ++i)
+    {
+        bundle_file.write(padding,(std::streamsize)((*assets)[i].entry.offset - position));
+        if (!(*assets)[i].data.empty())
+            bundle_file.write((const char *)&(*assets)[i].data[0],(std::streamsize)(*assets)[i].data.size());
+        position = (*assets)[i].entry.offset + (*assets)[i].entry.size;
+    }
+
+    return bundle_file.good();
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 4)
+    {
+        std::cout << "usage: bundlepack <textures dir> <sounds dir> <bundle file>\n";
+        return 1;
+    }
+
+    std::vector<packed_asset> assets;
+    bool packed = addAsset(&assets,argv[1],FONT_FILE_NAME,BUNDLEENTRY_IMAGE);
+
+    for (int i = 0; i < NUM_TOTAL_TEXTURES && packed; ++i)
+        packed = addAsset(&assets,argv[1],texture_file_names[i],BUNDLEENTRY_IMAGE);
+
+    for (int i = 0; i < NUM_TOTAL_SOUNDS && packed; ++i)
+        packed = addAsset(&assets,argv[2],sound_file_names[i],BUNDLEENTRY_SOUND);
+
+    if (!packed)
+        return 1;
+
+    if (!writeBundle(argv[3],&assets))
+    {
+        std::cout << "Could not write " << argv[3] << "\n";
+        return 1;
+    }
+
+    std::cout << "Packed " << assets.size() << " assets into " << argv[3] << "\n";
+    return 0;
+}